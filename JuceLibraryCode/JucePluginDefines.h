@@ -32,7 +32,7 @@
  #define JucePlugin_Build_Unity            0
 #endif
 #ifndef  JucePlugin_Build_LV2
- #define JucePlugin_Build_LV2              0
+ #define JucePlugin_Build_LV2              1
 #endif
 #ifndef  JucePlugin_Enable_IAA
  #define JucePlugin_Enable_IAA             0
@@ -145,6 +145,9 @@
 #ifndef  JucePlugin_VSTNumMidiOutputs
  #define JucePlugin_VSTNumMidiOutputs      16
 #endif
+#ifndef  JucePlugin_LV2URI
+ #define JucePlugin_LV2URI                 "https://www.yourcompany.com/plugins/FreqencyDependentDelayer"
+#endif
 #ifndef  JucePlugin_ARAContentTypes
  #define JucePlugin_ARAContentTypes        0
 #endif
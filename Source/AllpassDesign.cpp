@@ -0,0 +1,298 @@
+/*
+  ==============================================================================
+
+    Fits a cascade of second order allpass sections to a user drawn
+    group delay curve. Fitting runs on a background thread, the audio thread
+    only picks up finished designs.
+
+  ==============================================================================
+*/
+
+#include "AllpassDesign.h"
+
+namespace
+{
+    constexpr int num_grid_points = 48;
+    constexpr int max_refine_iterations = 200;
+    constexpr double min_fit_frequency = 20.;
+    constexpr double max_radius = 0.9995;
+    constexpr double peak_tolerance_samples = 0.5;
+
+    struct Fit_Grid {
+        std::vector<double> frequency, w, target; // target in samples
+    };
+
+    // A section peaks at (1 + r) / (1 - r) samples at its centre frequency.
+    double peak_to_radius(double peak_samples)
+    {
+        auto peak = juce::jmax(1., peak_samples);
+        return juce::jlimit(0., max_radius, (peak - 1) / (peak + 1));
+    }
+
+    double radius_to_peak(double radius)
+    {
+        return (1 + radius) / (1 - radius);
+    }
+
+    // Sum of squared residuals around their mean; the mean is absorbed by the pure delay.
+    double residual_error(const Fit_Grid& grid, const std::vector<Allpass_Section>& sections, double sample_rate, std::vector<double>& residual, double& mean)
+    {
+        mean = 0;
+        for (int i = 0; i < num_grid_points; i++)
+        {
+            double model = 0;
+            for (auto& section : sections)
+                model += allpass_group_delay(section, grid.w[i], sample_rate);
+            residual[i] = grid.target[i] - model;
+            mean += residual[i];
+        }
+        mean /= num_grid_points;
+
+        double error = 0;
+        for (auto r : residual)
+            error += (r - mean) * (r - mean);
+        return error;
+    }
+
+    double refine(const Fit_Grid& grid, std::vector<Allpass_Section>& sections, double sample_rate, double error)
+    {
+        std::vector<double> residual(num_grid_points);
+        double mean;
+        double step = 0.1;
+        auto min_frequency = grid.frequency.front();
+        auto max_frequency = grid.frequency.back();
+
+        for (int iteration = 0; iteration < max_refine_iterations && step > 1e-3; iteration++)
+        {
+            bool improved = false;
+            for (auto& section : sections)
+            {
+                for (int parameter = 0; parameter < 2; parameter++)
+                {
+                    for (double direction : { 1., -1. })
+                    {
+                        auto saved = section;
+                        if (parameter == 0)
+                            section.frequency = juce::jlimit(min_frequency, max_frequency, section.frequency * std::exp(direction * step));
+                        else
+                            section.radius = peak_to_radius(radius_to_peak(section.radius) * std::exp(direction * step));
+
+                        auto trial = residual_error(grid, sections, sample_rate, residual, mean);
+                        if (trial < error)
+                        {
+                            error = trial;
+                            improved = true;
+                            break;
+                        }
+                        section = saved;
+                    }
+                }
+            }
+            if (!improved)
+                step *= 0.5;
+        }
+        return error;
+    }
+}
+
+double interpolate_curve(const Curve_Point* sorted_curve, int num_points, double frequency)
+{
+    if (num_points <= 0)
+        return 0.;
+    if (frequency <= sorted_curve[0].frequency)
+        return sorted_curve[0].delay_ms;
+    if (frequency >= sorted_curve[num_points - 1].frequency)
+        return sorted_curve[num_points - 1].delay_ms;
+
+    for (int i = 1; i < num_points; i++)
+    {
+        auto& lower = sorted_curve[i - 1];
+        auto& upper = sorted_curve[i];
+        if (frequency <= upper.frequency)
+        {
+            auto position = std::log(frequency / lower.frequency) / std::log((double)upper.frequency / lower.frequency);
+            return lower.delay_ms + position * (upper.delay_ms - lower.delay_ms);
+        }
+    }
+    return sorted_curve[num_points - 1].delay_ms;
+}
+
+double allpass_group_delay(const Allpass_Section& section, double w, double sample_rate)
+{
+    auto theta = juce::MathConstants<double>::twoPi * section.frequency / sample_rate;
+    auto r = section.radius;
+    auto numerator = 1 - r * r;
+    return numerator / (1 - 2 * r * std::cos(w - theta) + r * r)
+        + numerator / (1 - 2 * r * std::cos(w + theta) + r * r);
+}
+
+float fit_allpass_sections(const std::vector<Curve_Point>& curve, double sample_rate, std::vector<Allpass_Section>& sections)
+{
+    if (curve.empty() || sample_rate <= 0)
+    {
+        sections.clear();
+        return 0.f;
+    }
+
+    auto sorted_curve = curve;
+    std::sort(sorted_curve.begin(), sorted_curve.end(),
+        [](const Curve_Point& a, const Curve_Point& b) { return a.frequency < b.frequency; });
+
+    auto max_frequency = juce::jmin(20000., 0.45 * sample_rate);
+    Fit_Grid grid;
+    for (int i = 0; i < num_grid_points; i++)
+    {
+        auto frequency = min_fit_frequency * std::pow(max_frequency / min_fit_frequency, i / (num_grid_points - 1.));
+        grid.frequency.push_back(frequency);
+        grid.w.push_back(juce::MathConstants<double>::twoPi * frequency / sample_rate);
+        grid.target.push_back(interpolate_curve(sorted_curve.data(), (int)sorted_curve.size(), frequency) * sample_rate / 1000);
+    }
+
+    // sections from a previous fit may be out of range after a sample rate change
+    sections.erase(std::remove_if(sections.begin(), sections.end(),
+        [&](const Allpass_Section& s) { return s.frequency < min_fit_frequency || s.frequency > max_frequency; }),
+        sections.end());
+
+    std::vector<double> residual(num_grid_points);
+    double mean;
+    auto error = residual_error(grid, sections, sample_rate, residual, mean);
+    for (;;)
+    {
+        error = refine(grid, sections, sample_rate, error);
+        residual_error(grid, sections, sample_rate, residual, mean);
+
+        int worst = 0;
+        for (int i = 1; i < num_grid_points; i++)
+        {
+            if (residual[i] > residual[worst])
+                worst = i;
+        }
+        auto peak = residual[worst] - mean;
+        if ((int)sections.size() >= max_allpass_sections || peak < peak_tolerance_samples)
+            break;
+
+        sections.push_back({ grid.frequency[worst], peak_to_radius(peak) });
+        auto new_error = residual_error(grid, sections, sample_rate, residual, mean);
+        if (new_error >= error)
+        {
+            sections.pop_back();
+            break;
+        }
+        error = new_error;
+    }
+
+    residual_error(grid, sections, sample_rate, residual, mean);
+    return (float)(juce::jmax(0., mean) * 1000 / sample_rate);
+}
+
+juce::dsp::IIR::Coefficients<float>::Ptr make_allpass_coefficients(const Allpass_Section& section, double sample_rate)
+{
+    auto theta = juce::MathConstants<double>::twoPi * section.frequency / sample_rate;
+    auto a1 = (float)(-2 * section.radius * std::cos(theta));
+    auto a2 = (float)(section.radius * section.radius);
+    return *new juce::dsp::IIR::Coefficients<float>(a2, a1, 1.f, 1.f, a1, a2);
+}
+
+//==============================================================================
+Allpass_Fitter::Allpass_Fitter() : juce::Thread("Allpass Fitter")
+{
+}
+
+Allpass_Fitter::~Allpass_Fitter()
+{
+    signalThreadShouldExit();
+    notify();
+    stopThread(2000);
+}
+
+void Allpass_Fitter::start()
+{
+    // a request made before the start is still signalled, the first wait() returns at once
+    if (!isThreadRunning())
+        startThread();
+}
+
+void Allpass_Fitter::set_curve(const std::vector<Curve_Point>& curve)
+{
+    {
+        const juce::ScopedLock lock(request_lock);
+        requested_curve = curve;
+        requested_generation++;
+    }
+    if (!curve.empty())
+        start();
+    notify();
+}
+
+void Allpass_Fitter::set_sample_rate(double sample_rate)
+{
+    {
+        const juce::ScopedLock lock(request_lock);
+        if (sample_rate == requested_sample_rate)
+            return; // the last result still holds
+        requested_sample_rate = sample_rate;
+        requested_generation++;
+    }
+    notify();
+}
+
+bool Allpass_Fitter::wait_for_design(int timeout_ms)
+{
+    int generation;
+    {
+        const juce::ScopedLock lock(request_lock);
+        if (requested_sample_rate <= 0)
+            return false;
+        generation = requested_generation;
+    }
+    start();
+
+    auto deadline = juce::Time::getMillisecondCounter() + (juce::uint32)timeout_ms;
+    while (fitted_generation.load() < generation)
+    {
+        auto now = juce::Time::getMillisecondCounter();
+        if (now >= deadline)
+            return false;
+        fitted.wait((int)(deadline - now));
+    }
+    return true;
+}
+
+void Allpass_Fitter::run()
+{
+    while (!threadShouldExit())
+    {
+        wait(-1);
+        if (threadShouldExit())
+            return;
+
+        std::vector<Curve_Point> curve;
+        double sample_rate;
+        int generation;
+        {
+            const juce::ScopedLock lock(request_lock);
+            curve = requested_curve;
+            sample_rate = requested_sample_rate;
+            generation = requested_generation;
+        }
+        // notifications that arrive while fitting wake the thread once more; refitting
+        // the same request from the last solution would move the design needlessly
+        if (sample_rate <= 0 || generation == fitting_generation)
+            continue;
+        fitting_generation = generation;
+
+        Allpass_Design design;
+        design.base_delay_ms = fit_allpass_sections(curve, sample_rate, sections);
+        design.sections = sections;
+        for (auto& section : sections)
+            design.coefficients.push_back(make_allpass_coefficients(section, sample_rate));
+
+        {
+            juce::SpinLock::ScopedLockType lock(result_lock);
+            result = std::move(design);
+            result_ready = true;
+        }
+        fitted_generation = generation;
+        fitted.signal();
+    }
+}
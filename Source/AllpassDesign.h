@@ -0,0 +1,92 @@
+/*
+  ==============================================================================
+
+    Fits a cascade of second order allpass sections to a user drawn
+    group delay curve. Fitting runs on a background thread, the audio thread
+    only picks up finished designs.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <vector>
+
+constexpr int max_allpass_sections = 16;
+
+struct Curve_Point {
+    float frequency{ 1000.f }, delay_ms{ 0.f };
+};
+
+struct Allpass_Section {
+    double frequency{ 1000. }, radius{ 0. };
+};
+
+struct Allpass_Design {
+    std::vector<Allpass_Section> sections;
+    std::vector<juce::dsp::IIR::Coefficients<float>::Ptr> coefficients;
+    float base_delay_ms{ 0.f };
+};
+
+// Delay in ms of a curve sorted by frequency, linear over log frequency.
+double interpolate_curve(const Curve_Point* sorted_curve, int num_points, double frequency);
+
+// Group delay in samples of a single section at normalised angular frequency w.
+double allpass_group_delay(const Allpass_Section& section, double w, double sample_rate);
+
+// Refines `sections` in place (starting from whatever it holds) so that the
+// cascade plus a pure delay follows `curve`. Returns the pure delay in ms.
+float fit_allpass_sections(const std::vector<Curve_Point>& curve, double sample_rate, std::vector<Allpass_Section>& sections);
+
+juce::dsp::IIR::Coefficients<float>::Ptr make_allpass_coefficients(const Allpass_Section& section, double sample_rate);
+
+class Allpass_Fitter : private juce::Thread {
+public:
+    Allpass_Fitter();
+    ~Allpass_Fitter() override;
+
+    // Message thread. The fitting thread starts with the first curve that has points
+    // or when the allpass mode is first chosen; an instance that uses neither has none.
+    void start();
+    bool is_running() const { return isThreadRunning(); }
+
+    // Message thread: request a (re)fit, the previous solution is the starting point.
+    void set_curve(const std::vector<Curve_Point>& curve);
+    void set_sample_rate(double sample_rate);
+    // Starts the thread and blocks until everything requested so far is fitted, so
+    // offline renders do not depend on its timing. False on a timeout or without a sample rate.
+    bool wait_for_design(int timeout_ms);
+
+    // Audio thread: calls install(const Allpass_Design&) if a new design is waiting.
+    template<typename Install>
+    bool consume(Install&& install) {
+        if (!result_ready.load())
+            return false;
+        juce::SpinLock::ScopedTryLockType lock(result_lock);
+        if (!lock.isLocked())
+            return false;
+        install(result);
+        result_ready = false;
+        return true;
+    };
+
+private:
+    void run() override;
+
+    juce::CriticalSection request_lock;
+    std::vector<Curve_Point> requested_curve;
+    double requested_sample_rate{ 0. };
+    int requested_generation{ 0 };
+
+    std::vector<Allpass_Section> sections; // only touched by the fitting thread
+    int fitting_generation{ 0 };           // likewise
+
+    std::atomic<int> fitted_generation{ 0 };
+    juce::WaitableEvent fitted;
+
+    juce::SpinLock result_lock;
+    Allpass_Design result;
+    std::atomic<bool> result_ready{ false };
+};
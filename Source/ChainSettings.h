@@ -0,0 +1,44 @@
+/*
+  ==============================================================================
+
+    Parameter snapshot shared by the processor, presets and morphing.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <functional>
+#include "SplitEngine.h"
+
+enum Delay_Mode {
+    Mode_Split,
+    Mode_Allpass,
+    Mode_Spectral,
+    Mode_Multirate
+};
+
+// What the sidechain delay estimate is used for.
+enum Estimation_Mode {
+    Estimation_Off,
+    Estimation_Suggest,
+    Estimation_Apply
+};
+
+struct Chain_Settings {
+    float low_pass_freq{ 20000.f }, high_pass_freq{ 20.f }, delay_ms{ 0.f };
+    Slope low_pass_slope{ Slope::Slope_12 }, high_pass_slope{ Slope::Slope_12 };
+    Delay_Storage delay_storage{ Delay_Storage::Storage_Float };
+    Delay_Mode mode{ Delay_Mode::Mode_Split };
+    int hop_size_index{ 2 };
+    float morph{ 0.f };
+    bool morph_enabled{ false };
+    Estimation_Mode delay_estimation{ Estimation_Mode::Estimation_Off };
+};
+Chain_Settings get_chain_settings(juce::AudioProcessorValueTreeState& apvts);
+// Calls set(parameter id, value in the parameter's range) for every setting.
+void visit_chain_settings(const Chain_Settings& settings, const std::function<void(juce::StringRef, float)>& set);
+void set_chain_settings(juce::AudioProcessorValueTreeState& apvts, const Chain_Settings& settings);
+bool same_filters(const Chain_Settings& a, const Chain_Settings& b);
+Split_Params get_split_params(const Chain_Settings& settings);
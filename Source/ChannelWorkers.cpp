@@ -0,0 +1,89 @@
+/*
+  ==============================================================================
+
+    Small pool that spreads independent per-channel jobs over worker threads
+    during offline rendering. The calling thread takes part and returns once
+    every job of the block has finished.
+
+  ==============================================================================
+*/
+
+#include "ChannelWorkers.h"
+
+Channel_Workers::~Channel_Workers()
+{
+    stop();
+}
+
+void Channel_Workers::start(int num_workers)
+{
+    num_workers = juce::jmax(0, num_workers);
+    if (num_workers == (int)workers.size())
+        return;
+
+    stop();
+    for (int i = 0; i < num_workers; i++)
+    {
+        workers.push_back(std::make_unique<Worker>(*this, i));
+        workers.back()->startThread();
+    }
+}
+
+void Channel_Workers::stop()
+{
+    for (auto& worker : workers)
+        worker->signalThreadShouldExit();
+    for (auto& worker : workers)
+    {
+        worker->notify();
+        worker->stopThread(2000);
+    }
+    workers.clear();
+}
+
+void Channel_Workers::run(int num_jobs, const std::function<void(int)>& job)
+{
+    current_job = &job;
+    total_jobs = num_jobs;
+    jobs_done = 0;
+    next_job = 0;
+    active_workers = (int)workers.size();
+
+    for (auto& worker : workers)
+        worker->notify();
+
+    take_jobs();
+
+    // joining every worker (not just the jobs) keeps late workers out of the next block
+    while (jobs_done.load() < num_jobs || active_workers.load() > 0)
+        juce::Thread::yield();
+}
+
+void Channel_Workers::take_jobs()
+{
+    for (;;)
+    {
+        auto index = next_job.fetch_add(1);
+        if (index >= total_jobs.load())
+            return;
+        (*current_job.load())(index);
+        jobs_done.fetch_add(1);
+    }
+}
+
+Channel_Workers::Worker::Worker(Channel_Workers& o, int index)
+    : juce::Thread("Channel Worker " + juce::String(index)), owner(o)
+{
+}
+
+void Channel_Workers::Worker::run()
+{
+    while (!threadShouldExit())
+    {
+        wait(-1);
+        if (threadShouldExit())
+            return;
+        owner.take_jobs();
+        owner.active_workers.fetch_sub(1);
+    }
+}
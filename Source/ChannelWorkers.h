@@ -0,0 +1,47 @@
+/*
+  ==============================================================================
+
+    Small pool that spreads independent per-channel jobs over worker threads
+    during offline rendering. The calling thread takes part and returns once
+    every job of the block has finished.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class Channel_Workers {
+public:
+    ~Channel_Workers();
+
+    // Message thread; restarts the pool only if the worker count changes.
+    void start(int num_workers);
+    void stop();
+    int get_num_workers() const { return (int)workers.size(); }
+
+    // Runs job(0 .. num_jobs - 1). Every thread claims the next job from one shared
+    // atomic counter, so idle threads keep taking whatever is left instead of a fixed
+    // share; there are no per-thread queues and nothing is stolen.
+    void run(int num_jobs, const std::function<void(int)>& job);
+
+private:
+    class Worker : public juce::Thread {
+    public:
+        Worker(Channel_Workers& owner, int index);
+        void run() override;
+    private:
+        Channel_Workers& owner;
+    };
+
+    void take_jobs();
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<const std::function<void(int)>*> current_job{ nullptr };
+    std::atomic<int> next_job{ 0 }, total_jobs{ 0 }, jobs_done{ 0 }, active_workers{ 0 };
+};
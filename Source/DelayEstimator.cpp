@@ -0,0 +1,300 @@
+/*
+  ==============================================================================
+
+    Estimates the delay between the sidechain (the reference) and the main
+    input with GCC-PHAT, separately for the filtered band and the rest. The
+    audio thread only pushes raw samples into a FIFO; decimation, FFTs and
+    peak picking run on a background thread.
+
+  ==============================================================================
+*/
+
+#include "DelayEstimator.h"
+
+namespace
+{
+    constexpr double analysis_rate = 16000.;
+    constexpr int analysis_interval_ms = 50;
+    constexpr float min_confidence = 6.f;
+    constexpr float min_rms = 1e-4f;
+    constexpr float cross_spectrum_smoothing = 0.3f; // weight of the newest frame
+    constexpr float estimate_smoothing = 0.2f;       // weight of the newest suggestion
+    constexpr float commit_threshold_ms = 0.5f;
+
+    float rms(const std::vector<float>& samples)
+    {
+        double sum = 0.;
+        for (auto sample : samples)
+            sum += sample * sample;
+        return (float)std::sqrt(sum / juce::jmax((size_t)1, samples.size()));
+    }
+}
+
+bool suggest_delay(const Band_Lag& filtered, const Band_Lag& rest, float& delay_ms)
+{
+    // only the difference between the bands can be corrected; a band on its own
+    // gets delayed when the reference lags it
+    if (filtered.valid && rest.valid)
+        delay_ms = rest.lag_ms - filtered.lag_ms;
+    else if (filtered.valid)
+        delay_ms = -juce::jmax(0.f, filtered.lag_ms);
+    else if (rest.valid)
+        delay_ms = juce::jmax(0.f, rest.lag_ms);
+    else
+        return false;
+    return true;
+}
+
+//==============================================================================
+Delay_Estimator::Delay_Estimator() : juce::Thread("Delay Estimator")
+{
+}
+
+Delay_Estimator::~Delay_Estimator()
+{
+    set_running(false);
+}
+
+void Delay_Estimator::set_running(bool should_run)
+{
+    if (should_run == isThreadRunning())
+        return;
+
+    if (should_run)
+    {
+        startThread();
+        return;
+    }
+    signalThreadShouldExit();
+    notify();
+    stopThread(2000);
+}
+
+void Delay_Estimator::prepare(double new_sample_rate)
+{
+    const juce::ScopedLock lock(prepare_lock);
+    sample_rate = new_sample_rate;
+    decimation = juce::jmax(1, (int)(sample_rate / analysis_rate));
+    auto decimated_rate = sample_rate / decimation;
+
+    // the frame holds twice the largest lag, zero padding to twice that keeps the correlation linear
+    auto max_lag = (int)std::ceil(decimated_rate * max_estimated_delay_ms / 1000);
+    auto window_size = juce::nextPowerOfTwo(2 * max_lag);
+    auto fft_order = juce::roundToInt(std::log2(2 * window_size));
+    if (fft == nullptr || fft->getSize() != 1 << fft_order)
+        fft = std::make_unique<juce::dsp::FFT>(fft_order); // the twiddles cost more than the rest of prepare()
+
+    auto capacity = (int)sample_rate + 1; // a second of audio between analyses
+    fifo.setTotalSize(capacity);
+    input_fifo.assign((size_t)capacity, 0.f);
+    sidechain_fifo.assign((size_t)capacity, 0.f);
+    pop_buffer.assign((size_t)capacity, 0.f);
+
+    input_history.assign((size_t)window_size, 0.f);
+    sidechain_history.assign((size_t)window_size, 0.f);
+    decimation_phase = 0;
+    new_samples = 0;
+
+    auto first = juce::dsp::IIR::ArrayCoefficients<float>::makeLowPass(sample_rate, 0.4 * decimated_rate, 0.5412f);
+    auto second = juce::dsp::IIR::ArrayCoefficients<float>::makeLowPass(sample_rate, 0.4 * decimated_rate, 1.3066f);
+    for (size_t i = 0; i < anti_alias.size(); i++)
+    {
+        *anti_alias[i].coefficients = i % 2 == 0 ? first : second;
+        anti_alias[i].reset();
+    }
+
+    auto fft_size = (size_t)fft->getSize();
+    input_spectrum.assign(fft_size, {});
+    sidechain_spectrum.assign(fft_size, {});
+    correlation.assign(fft_size, {});
+    cross_spectrum.assign(fft_size, {});
+    cross_spectrum_empty = true;
+
+    has_estimate = false;
+    juce::SpinLock::ScopedLockType band_scope(band_lock);
+    filtered_lag = {};
+    rest_lag = {};
+}
+
+void Delay_Estimator::push(const float* input, const float* sidechain, int num_samples, float low_pass_freq, float high_pass_freq)
+{
+    band_low_pass_freq = low_pass_freq;
+    band_high_pass_freq = high_pass_freq;
+
+    // a block that does not fit whole is dropped, so both signals stay aligned
+    if (fifo.getFreeSpace() < num_samples)
+        return;
+
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite(num_samples, start1, size1, start2, size2);
+    std::copy(input, input + size1, input_fifo.data() + start1);
+    std::copy(sidechain, sidechain + size1, sidechain_fifo.data() + start1);
+    std::copy(input + size1, input + size1 + size2, input_fifo.data() + start2);
+    std::copy(sidechain + size1, sidechain + size1 + size2, sidechain_fifo.data() + start2);
+    fifo.finishedWrite(size1 + size2);
+}
+
+bool Delay_Estimator::get_delay_ms(float& delay_ms) const
+{
+    if (!has_estimate.load())
+        return false;
+    delay_ms = smoothed_delay_ms.load();
+    return true;
+}
+
+bool Delay_Estimator::get_applied_delay_ms(float& delay_ms) const
+{
+    if (!has_estimate.load())
+        return false;
+    delay_ms = applied_delay_ms.load();
+    return true;
+}
+
+Band_Lag Delay_Estimator::get_band_lag(bool filtered_band) const
+{
+    juce::SpinLock::ScopedLockType lock(band_lock);
+    return filtered_band ? filtered_lag : rest_lag;
+}
+
+void Delay_Estimator::run()
+{
+    while (!threadShouldExit())
+    {
+        wait(analysis_interval_ms);
+        if (threadShouldExit())
+            return;
+
+        const juce::ScopedLock lock(prepare_lock);
+        if (sample_rate > 0)
+            analyse();
+    }
+}
+
+void Delay_Estimator::analyse()
+{
+    // decimate whatever arrived into the end of the histories
+    auto decimate = [this](std::vector<float>& fifo_data, std::vector<float>& history, int filter_index, int start, int size, int phase) {
+        int count = 0;
+        for (int i = 0; i < size; i++)
+        {
+            auto sample = fifo_data[(size_t)(start + i)];
+            if (decimation > 1)
+                sample = anti_alias[(size_t)filter_index + 1].processSample(anti_alias[(size_t)filter_index].processSample(sample));
+            if (phase == 0)
+                pop_buffer[(size_t)count++] = sample;
+            phase = phase + 1 == decimation ? 0 : phase + 1;
+        }
+        auto copied = (std::ptrdiff_t)juce::jmin((size_t)count, history.size());
+        std::copy(history.begin() + copied, history.end(), history.begin());
+        std::copy(pop_buffer.begin() + (count - copied), pop_buffer.begin() + count, history.end() - copied);
+        return std::make_pair(count, phase);
+    };
+
+    int start1, size1, start2, size2;
+    fifo.prepareToRead(fifo.getNumReady(), start1, size1, start2, size2);
+    for (auto [start, size] : { std::make_pair(start1, size1), std::make_pair(start2, size2) })
+    {
+        if (size == 0)
+            continue;
+        decimate(input_fifo, input_history, 0, start, size, decimation_phase);
+        auto [count, phase] = decimate(sidechain_fifo, sidechain_history, 2, start, size, decimation_phase);
+        decimation_phase = phase;
+        new_samples += count;
+    }
+    fifo.finishedRead(size1 + size2);
+
+    // a new analysis every quarter frame
+    if (new_samples < (int)input_history.size() / 4)
+        return;
+    new_samples = 0;
+    if (rms(input_history) < min_rms || rms(sidechain_history) < min_rms)
+        return;
+
+    auto fft_size = input_spectrum.size();
+    std::fill(input_spectrum.begin(), input_spectrum.end(), std::complex<float>{});
+    std::fill(sidechain_spectrum.begin(), sidechain_spectrum.end(), std::complex<float>{});
+    for (size_t i = 0; i < input_history.size(); i++)
+    {
+        input_spectrum[i] = input_history[i];
+        sidechain_spectrum[i] = sidechain_history[i];
+    }
+    fft->perform(input_spectrum.data(), input_spectrum.data(), false);
+    fft->perform(sidechain_spectrum.data(), sidechain_spectrum.data(), false);
+
+    auto weight = cross_spectrum_empty ? 1.f : cross_spectrum_smoothing;
+    for (size_t k = 0; k < fft_size; k++)
+    {
+        cross_spectrum[k] += weight * (std::conj(input_spectrum[k]) * sidechain_spectrum[k] - cross_spectrum[k]);
+    }
+    cross_spectrum_empty = false;
+
+    auto low_pass_freq = band_low_pass_freq.load();
+    auto high_pass_freq = band_high_pass_freq.load();
+    auto filtered = find_peak(true, low_pass_freq, high_pass_freq);
+    auto rest = find_peak(false, low_pass_freq, high_pass_freq);
+    {
+        juce::SpinLock::ScopedLockType lock(band_lock);
+        filtered_lag = filtered;
+        rest_lag = rest;
+    }
+
+    float delay_ms;
+    if (!suggest_delay(filtered, rest, delay_ms))
+        return;
+    delay_ms = juce::jlimit(-max_estimated_delay_ms, max_estimated_delay_ms, delay_ms);
+    if (has_estimate.load())
+        delay_ms = smoothed_delay_ms.load() + estimate_smoothing * (delay_ms - smoothed_delay_ms.load());
+    smoothed_delay_ms = delay_ms;
+    if (!has_estimate.load() || std::abs(delay_ms - applied_delay_ms.load()) > commit_threshold_ms)
+        applied_delay_ms = delay_ms;
+    has_estimate = true;
+}
+
+Band_Lag Delay_Estimator::find_peak(bool filtered_band, float low_pass_freq, float high_pass_freq)
+{
+    // phase transform: every bin of the band counts the same, whatever its level
+    auto fft_size = (int)correlation.size();
+    auto decimated_rate = sample_rate / decimation;
+    std::fill(correlation.begin(), correlation.end(), std::complex<float>{});
+    int num_bins = 0;
+    for (int k = 1; k < fft_size / 2; k++)
+    {
+        auto frequency = (float)(k * decimated_rate / fft_size);
+        if (frequency > 0.4 * decimated_rate || frequency < 20.f)
+            continue;
+        auto in_band = frequency >= high_pass_freq && frequency <= low_pass_freq;
+        auto magnitude = std::abs(cross_spectrum[(size_t)k]);
+        if (in_band != filtered_band || magnitude <= 0.f)
+            continue;
+
+        correlation[(size_t)k] = cross_spectrum[(size_t)k] / magnitude;
+        correlation[(size_t)(fft_size - k)] = std::conj(correlation[(size_t)k]);
+        num_bins++;
+    }
+    if (num_bins < 8)
+        return {};
+    fft->perform(correlation.data(), correlation.data(), true);
+
+    auto max_lag = juce::jmin(fft_size / 4, (int)std::ceil(decimated_rate * max_estimated_delay_ms / 1000));
+    auto value = [&](int lag) { return correlation[(size_t)((lag + fft_size) % fft_size)].real(); };
+    int peak = 0;
+    double sum = 0.;
+    for (int lag = -max_lag; lag <= max_lag; lag++)
+    {
+        sum += (double)value(lag) * value(lag);
+        if (value(lag) > value(peak))
+            peak = lag;
+    }
+    auto peak_rms = (float)std::sqrt(sum / (2 * max_lag + 1));
+
+    // parabolic interpolation between the neighbours
+    auto left = value(peak - 1), centre = value(peak), right = value(peak + 1);
+    auto denominator = left - 2 * centre + right;
+    auto offset = denominator < 0.f ? 0.5f * (left - right) / denominator : 0.f;
+
+    Band_Lag lag;
+    lag.lag_ms = (float)((peak + offset) * 1000 / decimated_rate);
+    lag.confidence = peak_rms > 0.f ? centre / peak_rms : 0.f;
+    lag.valid = lag.confidence >= min_confidence;
+    return lag;
+}
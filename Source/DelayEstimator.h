@@ -0,0 +1,84 @@
+/*
+  ==============================================================================
+
+    Estimates the delay between the sidechain (the reference) and the main
+    input with GCC-PHAT, separately for the filtered band and the rest. The
+    audio thread only pushes raw samples into a FIFO; decimation, FFTs and
+    peak picking run on a background thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <complex>
+#include <memory>
+#include <vector>
+
+constexpr float max_estimated_delay_ms = 250.f;
+
+struct Band_Lag {
+    float lag_ms{ 0.f };   // how much later the sidechain arrives
+    float confidence{ 0.f }; // correlation peak over its rms
+    bool valid{ false };
+};
+
+// Delay parameter value that lines both bands up with the reference, given
+// that Delay < 0 delays the filtered band and Delay > 0 the rest.
+bool suggest_delay(const Band_Lag& filtered, const Band_Lag& rest, float& delay_ms);
+
+class Delay_Estimator : private juce::Thread {
+public:
+    Delay_Estimator();
+    ~Delay_Estimator() override;
+
+    // Message thread. The analysis thread only runs while someone needs it,
+    // an instance without a sidechain or with estimation off has none.
+    void set_running(bool should_run);
+    bool is_running() const { return isThreadRunning(); }
+
+    // Not on the audio thread; drops everything analysed so far.
+    void prepare(double sample_rate);
+
+    // Audio thread: copies the first channel of both, nothing else.
+    void push(const float* input, const float* sidechain, int num_samples, float low_pass_freq, float high_pass_freq);
+
+    // Smoothed suggestion, false until a confident estimate exists.
+    bool get_delay_ms(float& delay_ms) const;
+    // The suggestion as Apply uses it: it only moves once the smoothed one has
+    // drifted further than commit_threshold_ms, so the delay doesn't creep.
+    bool get_applied_delay_ms(float& delay_ms) const;
+    Band_Lag get_band_lag(bool filtered_band) const;
+
+private:
+    void run() override;
+    void analyse();
+    Band_Lag find_peak(bool filtered_band, float low_pass_freq, float high_pass_freq);
+
+    juce::CriticalSection prepare_lock; // held by prepare() and by the thread while it works
+    double sample_rate{ 0. };
+    int decimation{ 1 };
+
+    // raw capture, written by the audio thread
+    juce::AbstractFifo fifo{ 1 };
+    std::vector<float> input_fifo, sidechain_fifo;
+    std::atomic<float> band_low_pass_freq{ 20000.f }, band_high_pass_freq{ 20.f };
+
+    // decimated history, oldest first
+    std::array<juce::dsp::IIR::Filter<float>, 4> anti_alias; // two sections for input, two for sidechain
+    std::vector<float> input_history, sidechain_history, pop_buffer;
+    int decimation_phase{ 0 }, new_samples{ 0 };
+
+    std::unique_ptr<juce::dsp::FFT> fft;
+    std::vector<std::complex<float>> input_spectrum, sidechain_spectrum, correlation;
+    std::vector<std::complex<float>> cross_spectrum; // averaged over analyses
+    bool cross_spectrum_empty{ true };
+
+    std::atomic<float> smoothed_delay_ms{ 0.f }, applied_delay_ms{ 0.f };
+    std::atomic<bool> has_estimate{ false };
+    juce::SpinLock band_lock;
+    Band_Lag filtered_lag, rest_lag;
+};
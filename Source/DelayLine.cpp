@@ -0,0 +1,150 @@
+/*
+  ==============================================================================
+
+    Preallocated ring buffer delay used for the shifted band.
+
+  ==============================================================================
+*/
+
+#include "DelayLine.h"
+
+void Delay_Line::prepare(int max_delay_samples, int max_block_size, const Dsp_Kernels& new_kernels)
+{
+    kernels = &new_kernels;
+    max_delay = juce::jmax(0, max_delay_samples);
+    block_size = juce::jmax(1, max_block_size);
+    capacity = max_delay + block_size;
+
+    store.assign((size_t)capacity * bytes_per_sample(storage), 0);
+    fade_buffer.assign((size_t)block_size, 0.f);
+    write_position = 0;
+    delay = target_delay = juce::jmin(target_delay, max_delay);
+    fade_remaining = 0;
+}
+
+void Delay_Line::reset()
+{
+    std::fill(store.begin(), store.end(), (std::uint8_t)0);
+    write_position = 0;
+    delay = target_delay;
+    fade_remaining = 0;
+}
+
+void Delay_Line::set_storage(Delay_Storage new_storage)
+{
+    if (new_storage == storage)
+        return;
+
+    storage = new_storage;
+    // swapped rather than assigned, so the old format's memory is given back
+    std::vector<std::uint8_t>((size_t)capacity * bytes_per_sample(storage), 0).swap(store);
+    write_position = 0;
+}
+
+void Delay_Line::set_delay(int delay_samples, int fade_samples)
+{
+    target_delay = juce::jlimit(0, max_delay, delay_samples);
+    if (fade_samples <= 0)
+    {
+        delay = target_delay;
+        fade_remaining = 0;
+        return;
+    }
+
+    fade_length = fade_samples;
+    if (fade_remaining == 0 && target_delay != delay)
+    {
+        fade_from = delay;
+        delay = target_delay;
+        fade_remaining = fade_length;
+    }
+}
+
+void Delay_Line::process(float* buffer, int num_samples)
+{
+    if (capacity == 0 || (delay == 0 && fade_remaining == 0))
+    {
+        // keep the history running so that switching the delay on is seamless
+        for (int start = 0; start < num_samples; start += block_size)
+            write_block(buffer + start, juce::jmin(block_size, num_samples - start));
+        return;
+    }
+
+    for (int start = 0; start < num_samples; start += block_size)
+    {
+        int n = juce::jmin(block_size, num_samples - start);
+        write_block(buffer + start, n);
+        if (fade_remaining > 0)
+            fade_block(buffer + start, n);
+        else
+            read_block(buffer + start, n, delay);
+    }
+}
+
+void Delay_Line::fade_block(float* buffer, int num_samples)
+{
+    read_block(fade_buffer.data(), num_samples, fade_from);
+    read_block(buffer, num_samples, delay);
+
+    int faded = fade_length - fade_remaining;
+    for (int i = 0; i < num_samples; i++)
+    {
+        auto gain = juce::jmin(1.f, (float)(faded + i + 1) / fade_length);
+        buffer[i] = fade_buffer[(size_t)i] + gain * (buffer[i] - fade_buffer[(size_t)i]);
+    }
+
+    fade_remaining = juce::jmax(0, fade_remaining - num_samples);
+    if (fade_remaining == 0 && target_delay != delay)
+    {
+        fade_from = delay;
+        delay = target_delay;
+        fade_remaining = fade_length;
+    }
+}
+
+void Delay_Line::write_block(const float* source, int num_samples)
+{
+    int first = juce::jmin(num_samples, capacity - write_position);
+    write_segment(source, write_position, first);
+    if (first < num_samples)
+        write_segment(source + first, 0, num_samples - first);
+
+    write_position = (write_position + num_samples) % capacity;
+}
+
+void Delay_Line::read_block(float* destination, int num_samples, int delay_samples)
+{
+    // write_position already points behind the block that was just written
+    int read_position = write_position - num_samples - delay_samples;
+    while (read_position < 0)
+        read_position += capacity;
+
+    int first = juce::jmin(num_samples, capacity - read_position);
+    read_segment(destination, read_position, first);
+    if (first < num_samples)
+        read_segment(destination + first, 0, num_samples - first);
+}
+
+void Delay_Line::write_segment(const float* source, int position, int num_samples)
+{
+    if (storage == Storage_Float)
+    {
+        auto* samples = reinterpret_cast<float*>(store.data());
+        juce::FloatVectorOperations::copy(samples + position, source, num_samples);
+        return;
+    }
+
+    kernels->pack_24(store.data() + (size_t)position * 3, source, num_samples);
+}
+
+void Delay_Line::read_segment(float* destination, int position, int num_samples)
+{
+    if (storage == Storage_Float)
+    {
+        auto* samples = reinterpret_cast<const float*>(store.data());
+        juce::FloatVectorOperations::copy(destination, samples + position, num_samples);
+        return;
+    }
+
+    kernels->unpack_24(destination, store.data() + (size_t)position * 3, num_samples);
+}
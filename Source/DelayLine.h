@@ -0,0 +1,60 @@
+/*
+  ==============================================================================
+
+    Preallocated ring buffer delay used for the shifted band.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <cstdint>
+#include <vector>
+#include "DspKernels.h"
+
+enum Delay_Storage {
+    Storage_Float,
+    Storage_Packed_24
+};
+
+class Delay_Line {
+public:
+    // Allocates everything once; process() and set_delay() never allocate.
+    // The store holds 4 bytes per sample as floats and 3 when packed.
+    void prepare(int max_delay_samples, int max_block_size, const Dsp_Kernels& kernels);
+    void reset();
+
+    // Reallocates the store for the new format and clears the history,
+    // so not for the audio thread.
+    void set_storage(Delay_Storage new_storage);
+    // Jumps to the new delay, or with fade_samples > 0 fades over to it from a
+    // second read tap at the old one. A change during a fade follows once it ends.
+    void set_delay(int delay_samples, int fade_samples = 0);
+    int get_delay() const { return target_delay; }
+
+    void process(float* buffer, int num_samples);
+
+    size_t get_memory_bytes() const { return store.capacity(); }
+
+private:
+    static int bytes_per_sample(Delay_Storage storage) { return storage == Storage_Packed_24 ? 3 : (int)sizeof(float); }
+    void write_block(const float* source, int num_samples);
+    void read_block(float* destination, int num_samples, int delay_samples);
+    void fade_block(float* buffer, int num_samples);
+    void write_segment(const float* source, int position, int num_samples);
+    void read_segment(float* destination, int position, int num_samples);
+
+    const Dsp_Kernels* kernels = &get_dsp_kernels(Path_Scalar);
+    std::vector<std::uint8_t> store;
+    int capacity = 0;
+    int block_size = 0;
+    int max_delay = 0;
+    int write_position = 0;
+    int delay = 0;
+    Delay_Storage storage = Storage_Float;
+
+    std::vector<float> fade_buffer; // the old tap, one block
+    int target_delay = 0, fade_from = 0;
+    int fade_length = 0, fade_remaining = 0;
+};
@@ -0,0 +1,612 @@
+/*
+  ==============================================================================
+
+    Inner loops of the split and delay paths, built once per instruction set.
+    The best set the CPU supports is picked at prepareToPlay; FDD_CPU_PATH
+    (scalar, sse2, avx2, avx512, neon) or set_cpu_path_override() forces one.
+
+  ==============================================================================
+*/
+
+#include "DspKernels.h"
+
+// Every path has to match the scalar one bit for bit, so a multiply and an add
+// must not be fused into an FMA: avx2 and avx512f allow it for the whole function.
+#if JUCE_CLANG
+ #pragma clang fp contract(off)
+#elif JUCE_GCC
+ #pragma GCC optimize("fp-contract=off")
+#elif JUCE_MSVC
+ #pragma fp_contract(off)
+#endif
+
+#if JUCE_INTEL
+ #include <immintrin.h>
+ #define FDD_X86 1
+#endif
+#if JUCE_ARM && JUCE_64BIT && defined(__ARM_NEON)
+ #include <arm_neon.h>
+ #define FDD_NEON 1
+#endif
+
+// MSVC allows every intrinsic without flags, gcc and clang need the target per function
+#if JUCE_MSVC
+ #define FDD_TARGET(isa)
+#else
+ #define FDD_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+namespace
+{
+    std::atomic<int> cpu_path_override{ Path_Auto };
+
+    // Every path rounds to nearest even and scales by powers of two,
+    // so all of them produce bit identical output.
+    void store_24(std::uint8_t* bytes, std::int32_t value)
+    {
+        auto bits = (std::uint32_t)value;
+        bytes[0] = (std::uint8_t)bits;
+        bytes[1] = (std::uint8_t)(bits >> 8);
+        bytes[2] = (std::uint8_t)(bits >> 16);
+    }
+
+    std::int32_t load_24(const std::uint8_t* bytes)
+    {
+        auto value = (std::int32_t)((std::uint32_t)bytes[0] << 8
+            | (std::uint32_t)bytes[1] << 16
+            | (std::uint32_t)bytes[2] << 24);
+        return value >> 8; // sign extend
+    }
+
+    //==============================================================================
+    void subtract_scalar(float* cut, const float* data, int num_samples)
+    {
+        for (int i = 0; i < num_samples; i++)
+            cut[i] -= data[i];
+    }
+
+    void add_scalar(float* data, const float* cut, int num_samples)
+    {
+        for (int i = 0; i < num_samples; i++)
+            data[i] += cut[i];
+    }
+
+    void pack_24_scalar(std::uint8_t* bytes, const float* source, int num_samples)
+    {
+        for (int i = 0; i < num_samples; i++)
+        {
+            auto value = juce::jlimit(-packed_max, packed_max, source[i] * packed_scale);
+            store_24(bytes + 3 * i, juce::roundToInt(value));
+        }
+    }
+
+    void unpack_24_scalar(float* destination, const std::uint8_t* bytes, int num_samples)
+    {
+        for (int i = 0; i < num_samples; i++)
+            destination[i] = (float)load_24(bytes + 3 * i) * (1.f / packed_scale);
+    }
+
+    void cascade_scalar(float* data, int num_samples, Biquad_Cascade& cascade)
+    {
+        auto& c = cascade.coefficients;
+        for (int s = 0; s < cascade.num_sections; s++)
+        {
+            auto b0 = c[0][s], b1 = c[1][s], b2 = c[2][s], a1 = c[3][s], a2 = c[4][s];
+            auto s1 = cascade.state[0][s], s2 = cascade.state[1][s];
+            for (int i = 0; i < num_samples; i++)
+            {
+                auto x = data[i];
+                auto y = b0 * x + s1;
+                s1 = b1 * x - a1 * y + s2;
+                s2 = b2 * x - a2 * y;
+                data[i] = y;
+            }
+            cascade.state[0][s] = s1;
+            cascade.state[1][s] = s2;
+        }
+    }
+
+    // A single section gains nothing from the pipeline.
+    constexpr int min_pipelined_sections = 2;
+
+    const Dsp_Kernels scalar_kernels{ Path_Scalar, subtract_scalar, add_scalar, pack_24_scalar, unpack_24_scalar, cascade_scalar };
+
+#if FDD_X86
+    //==============================================================================
+    FDD_TARGET("sse2") void subtract_sse2(float* cut, const float* data, int num_samples)
+    {
+        int i = 0;
+        for (; i + 4 <= num_samples; i += 4)
+            _mm_storeu_ps(cut + i, _mm_sub_ps(_mm_loadu_ps(cut + i), _mm_loadu_ps(data + i)));
+        subtract_scalar(cut + i, data + i, num_samples - i);
+    }
+
+    FDD_TARGET("sse2") void add_sse2(float* data, const float* cut, int num_samples)
+    {
+        int i = 0;
+        for (; i + 4 <= num_samples; i += 4)
+            _mm_storeu_ps(data + i, _mm_add_ps(_mm_loadu_ps(data + i), _mm_loadu_ps(cut + i)));
+        add_scalar(data + i, cut + i, num_samples - i);
+    }
+
+    // SSE2 has no byte shuffle, only the float part is vectorised
+    FDD_TARGET("sse2") void pack_24_sse2(std::uint8_t* bytes, const float* source, int num_samples)
+    {
+        auto scale = _mm_set1_ps(packed_scale);
+        auto low = _mm_set1_ps(-packed_max), high = _mm_set1_ps(packed_max);
+        alignas(16) std::int32_t values[4];
+        int i = 0;
+        for (; i + 4 <= num_samples; i += 4)
+        {
+            auto x = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(source + i), scale), low), high);
+            _mm_store_si128(reinterpret_cast<__m128i*>(values), _mm_cvtps_epi32(x));
+            for (int k = 0; k < 4; k++)
+                store_24(bytes + 3 * (i + k), values[k]);
+        }
+        pack_24_scalar(bytes + 3 * i, source + i, num_samples - i);
+    }
+
+    FDD_TARGET("sse2") void unpack_24_sse2(float* destination, const std::uint8_t* bytes, int num_samples)
+    {
+        auto inverse_scale = _mm_set1_ps(1.f / packed_scale);
+        alignas(16) std::int32_t values[4];
+        int i = 0;
+        for (; i + 4 <= num_samples; i += 4)
+        {
+            for (int k = 0; k < 4; k++)
+                values[k] = load_24(bytes + 3 * (i + k));
+            auto x = _mm_cvtepi32_ps(_mm_load_si128(reinterpret_cast<const __m128i*>(values)));
+            _mm_storeu_ps(destination + i, _mm_mul_ps(x, inverse_scale));
+        }
+        unpack_24_scalar(destination + i, bytes + 3 * i, num_samples - i);
+    }
+
+    // Lane k runs section first + k on the sample lane 0 took k steps earlier. While
+    // the pipeline fills and drains, only lanes holding a sample of this block keep
+    // their new state; the others compute on values that are thrown away.
+    FDD_TARGET("sse2") void cascade_group_sse2(float* data, int num_samples, Biquad_Cascade& cascade, int first)
+    {
+        constexpr int lanes = 4;
+        auto& c = cascade.coefficients;
+        auto b0 = _mm_load_ps(c[0] + first), b1 = _mm_load_ps(c[1] + first), b2 = _mm_load_ps(c[2] + first);
+        auto a1 = _mm_load_ps(c[3] + first), a2 = _mm_load_ps(c[4] + first);
+        auto s1 = _mm_load_ps(cascade.state[0] + first), s2 = _mm_load_ps(cascade.state[1] + first);
+        auto lane = _mm_setr_ps(0.f, 1.f, 2.f, 3.f);
+        auto y = _mm_setzero_ps();
+        for (int t = 0; t < num_samples + lanes - 1; t++)
+        {
+            auto input = t < num_samples ? data[t] : 0.f;
+            auto x = _mm_move_ss(_mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(y), 4)), _mm_set_ss(input));
+            y = _mm_add_ps(_mm_mul_ps(b0, x), s1);
+            auto next_s1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, x), _mm_mul_ps(a1, y)), s2);
+            auto next_s2 = _mm_sub_ps(_mm_mul_ps(b2, x), _mm_mul_ps(a2, y));
+            if (t >= lanes - 1 && t < num_samples)
+            {
+                s1 = next_s1;
+                s2 = next_s2;
+            }
+            else
+            {
+                auto active = _mm_and_ps(_mm_cmple_ps(lane, _mm_set1_ps((float)t)), _mm_cmpgt_ps(lane, _mm_set1_ps((float)(t - num_samples))));
+                s1 = _mm_or_ps(_mm_and_ps(active, next_s1), _mm_andnot_ps(active, s1));
+                s2 = _mm_or_ps(_mm_and_ps(active, next_s2), _mm_andnot_ps(active, s2));
+            }
+            if (t >= lanes - 1)
+                data[t - (lanes - 1)] = _mm_cvtss_f32(_mm_shuffle_ps(y, y, _MM_SHUFFLE(3, 3, 3, 3)));
+        }
+        _mm_store_ps(cascade.state[0] + first, s1);
+        _mm_store_ps(cascade.state[1] + first, s2);
+    }
+
+    FDD_TARGET("sse2") void cascade_sse2(float* data, int num_samples, Biquad_Cascade& cascade)
+    {
+        if (cascade.num_sections < min_pipelined_sections)
+            return cascade_scalar(data, num_samples, cascade);
+        for (int first = 0; first < cascade.num_sections; first += 4)
+            cascade_group_sse2(data, num_samples, cascade, first);
+    }
+
+    const Dsp_Kernels sse2_kernels{ Path_SSE2, subtract_sse2, add_sse2, pack_24_sse2, unpack_24_sse2, cascade_sse2 };
+
+    //==============================================================================
+    FDD_TARGET("avx2") void subtract_avx2(float* cut, const float* data, int num_samples)
+    {
+        int i = 0;
+        for (; i + 8 <= num_samples; i += 8)
+            _mm256_storeu_ps(cut + i, _mm256_sub_ps(_mm256_loadu_ps(cut + i), _mm256_loadu_ps(data + i)));
+        subtract_scalar(cut + i, data + i, num_samples - i);
+    }
+
+    FDD_TARGET("avx2") void add_avx2(float* data, const float* cut, int num_samples)
+    {
+        int i = 0;
+        for (; i + 8 <= num_samples; i += 8)
+            _mm256_storeu_ps(data + i, _mm256_add_ps(_mm256_loadu_ps(data + i), _mm256_loadu_ps(cut + i)));
+        add_scalar(data + i, cut + i, num_samples - i);
+    }
+
+    // Byte shuffles stay inside 128 bit lanes, so every lane packs 4 samples into 12 bytes.
+    // The lanes go through a stack copy; storing 16 bytes straight into the ring
+    // would overwrite the 4 samples behind the block, which may still be read.
+    FDD_TARGET("avx2") void pack_24_avx2(std::uint8_t* bytes, const float* source, int num_samples)
+    {
+        auto scale = _mm256_set1_ps(packed_scale);
+        auto low = _mm256_set1_ps(-packed_max), high = _mm256_set1_ps(packed_max);
+        auto shuffle = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+        alignas(32) std::uint8_t lanes[32];
+        int i = 0;
+        for (; i + 8 <= num_samples; i += 8)
+        {
+            auto x = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(source + i), scale), low), high);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), _mm256_shuffle_epi8(_mm256_cvtps_epi32(x), shuffle));
+            std::memcpy(bytes + 3 * i, lanes, 12);
+            std::memcpy(bytes + 3 * i + 12, lanes + 16, 12);
+        }
+        pack_24_scalar(bytes + 3 * i, source + i, num_samples - i);
+    }
+
+    FDD_TARGET("avx2") void unpack_24_avx2(float* destination, const std::uint8_t* bytes, int num_samples)
+    {
+        auto inverse_scale = _mm256_set1_ps(1.f / packed_scale);
+        // every sample lands in the top 3 bytes, the arithmetic shift sign extends it
+        auto spread = _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+                                       -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+        alignas(32) std::uint8_t lanes[32] = {};
+        int i = 0;
+        for (; i + 8 <= num_samples; i += 8)
+        {
+            std::memcpy(lanes, bytes + 3 * i, 12);
+            std::memcpy(lanes + 16, bytes + 3 * i + 12, 12);
+            auto raw = _mm256_load_si256(reinterpret_cast<const __m256i*>(lanes));
+            auto values = _mm256_srai_epi32(_mm256_shuffle_epi8(raw, spread), 8);
+            _mm256_storeu_ps(destination + i, _mm256_mul_ps(_mm256_cvtepi32_ps(values), inverse_scale));
+        }
+        unpack_24_scalar(destination + i, bytes + 3 * i, num_samples - i);
+    }
+
+    FDD_TARGET("avx2") void cascade_group_avx2(float* data, int num_samples, Biquad_Cascade& cascade, int first)
+    {
+        constexpr int lanes = 8;
+        auto& c = cascade.coefficients;
+        auto b0 = _mm256_load_ps(c[0] + first), b1 = _mm256_load_ps(c[1] + first), b2 = _mm256_load_ps(c[2] + first);
+        auto a1 = _mm256_load_ps(c[3] + first), a2 = _mm256_load_ps(c[4] + first);
+        auto s1 = _mm256_load_ps(cascade.state[0] + first), s2 = _mm256_load_ps(cascade.state[1] + first);
+        auto lane = _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f);
+        auto rotate = _mm256_setr_epi32(7, 0, 1, 2, 3, 4, 5, 6);
+        auto y = _mm256_setzero_ps();
+        for (int t = 0; t < num_samples + lanes - 1; t++)
+        {
+            auto input = t < num_samples ? data[t] : 0.f;
+            auto x = _mm256_blend_ps(_mm256_permutevar8x32_ps(y, rotate), _mm256_set1_ps(input), 1);
+            y = _mm256_add_ps(_mm256_mul_ps(b0, x), s1);
+            auto next_s1 = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(b1, x), _mm256_mul_ps(a1, y)), s2);
+            auto next_s2 = _mm256_sub_ps(_mm256_mul_ps(b2, x), _mm256_mul_ps(a2, y));
+            if (t >= lanes - 1 && t < num_samples)
+            {
+                s1 = next_s1;
+                s2 = next_s2;
+            }
+            else
+            {
+                auto active = _mm256_and_ps(_mm256_cmp_ps(lane, _mm256_set1_ps((float)t), _CMP_LE_OQ),
+                    _mm256_cmp_ps(lane, _mm256_set1_ps((float)(t - num_samples)), _CMP_GT_OQ));
+                s1 = _mm256_blendv_ps(s1, next_s1, active);
+                s2 = _mm256_blendv_ps(s2, next_s2, active);
+            }
+            if (t >= lanes - 1)
+            {
+                auto high = _mm256_extractf128_ps(y, 1);
+                data[t - (lanes - 1)] = _mm_cvtss_f32(_mm_shuffle_ps(high, high, _MM_SHUFFLE(3, 3, 3, 3)));
+            }
+        }
+        _mm256_store_ps(cascade.state[0] + first, s1);
+        _mm256_store_ps(cascade.state[1] + first, s2);
+    }
+
+    // Short cascades take the narrowest pipeline that holds them, it fills and drains faster.
+    FDD_TARGET("avx2") void cascade_avx2(float* data, int num_samples, Biquad_Cascade& cascade)
+    {
+        if (cascade.num_sections < min_pipelined_sections)
+            return cascade_scalar(data, num_samples, cascade);
+        if (cascade.num_sections <= 4)
+            return cascade_group_sse2(data, num_samples, cascade, 0);
+        for (int first = 0; first < cascade.num_sections; first += 8)
+            cascade_group_avx2(data, num_samples, cascade, first);
+    }
+
+    const Dsp_Kernels avx2_kernels{ Path_AVX2, subtract_avx2, add_avx2, pack_24_avx2, unpack_24_avx2, cascade_avx2 };
+
+    //==============================================================================
+    FDD_TARGET("avx512f") void subtract_avx512(float* cut, const float* data, int num_samples)
+    {
+        int i = 0;
+        for (; i + 16 <= num_samples; i += 16)
+            _mm512_storeu_ps(cut + i, _mm512_sub_ps(_mm512_loadu_ps(cut + i), _mm512_loadu_ps(data + i)));
+        subtract_scalar(cut + i, data + i, num_samples - i);
+    }
+
+    FDD_TARGET("avx512f") void add_avx512(float* data, const float* cut, int num_samples)
+    {
+        int i = 0;
+        for (; i + 16 <= num_samples; i += 16)
+            _mm512_storeu_ps(data + i, _mm512_add_ps(_mm512_loadu_ps(data + i), _mm512_loadu_ps(cut + i)));
+        add_scalar(data + i, cut + i, num_samples - i);
+    }
+
+    // Byte shuffles across 512 bits need AVX-512BW, so the 4 lanes are packed like SSSE3 would.
+    FDD_TARGET("avx512f") void pack_24_avx512(std::uint8_t* bytes, const float* source, int num_samples)
+    {
+        auto scale = _mm512_set1_ps(packed_scale);
+        auto low = _mm512_set1_ps(-packed_max), high = _mm512_set1_ps(packed_max);
+        auto shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+        alignas(16) std::uint8_t lane[16];
+        int i = 0;
+        for (; i + 16 <= num_samples; i += 16)
+        {
+            auto x = _mm512_min_ps(_mm512_max_ps(_mm512_mul_ps(_mm512_loadu_ps(source + i), scale), low), high);
+            auto values = _mm512_cvtps_epi32(x);
+            auto* out = bytes + 3 * i;
+            _mm_store_si128(reinterpret_cast<__m128i*>(lane), _mm_shuffle_epi8(_mm512_extracti32x4_epi32(values, 0), shuffle));
+            std::memcpy(out, lane, 12);
+            _mm_store_si128(reinterpret_cast<__m128i*>(lane), _mm_shuffle_epi8(_mm512_extracti32x4_epi32(values, 1), shuffle));
+            std::memcpy(out + 12, lane, 12);
+            _mm_store_si128(reinterpret_cast<__m128i*>(lane), _mm_shuffle_epi8(_mm512_extracti32x4_epi32(values, 2), shuffle));
+            std::memcpy(out + 24, lane, 12);
+            _mm_store_si128(reinterpret_cast<__m128i*>(lane), _mm_shuffle_epi8(_mm512_extracti32x4_epi32(values, 3), shuffle));
+            std::memcpy(out + 36, lane, 12);
+        }
+        pack_24_scalar(bytes + 3 * i, source + i, num_samples - i);
+    }
+
+    FDD_TARGET("avx512f") void unpack_24_avx512(float* destination, const std::uint8_t* bytes, int num_samples)
+    {
+        auto inverse_scale = _mm512_set1_ps(1.f / packed_scale);
+        auto spread = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+        alignas(16) std::uint8_t lane[16] = {};
+        alignas(64) std::int32_t values[16];
+        int i = 0;
+        for (; i + 16 <= num_samples; i += 16)
+        {
+            for (int k = 0; k < 4; k++)
+            {
+                std::memcpy(lane, bytes + 3 * i + 12 * k, 12);
+                auto raw = _mm_load_si128(reinterpret_cast<const __m128i*>(lane));
+                _mm_store_si128(reinterpret_cast<__m128i*>(values + 4 * k), _mm_srai_epi32(_mm_shuffle_epi8(raw, spread), 8));
+            }
+            auto x = _mm512_cvtepi32_ps(_mm512_load_si512(values));
+            _mm512_storeu_ps(destination + i, _mm512_mul_ps(x, inverse_scale));
+        }
+        unpack_24_scalar(destination + i, bytes + 3 * i, num_samples - i);
+    }
+
+    FDD_TARGET("avx512f") void cascade_group_avx512(float* data, int num_samples, Biquad_Cascade& cascade, int first)
+    {
+        constexpr int lanes = 16;
+        auto& c = cascade.coefficients;
+        auto b0 = _mm512_load_ps(c[0] + first), b1 = _mm512_load_ps(c[1] + first), b2 = _mm512_load_ps(c[2] + first);
+        auto a1 = _mm512_load_ps(c[3] + first), a2 = _mm512_load_ps(c[4] + first);
+        auto s1 = _mm512_load_ps(cascade.state[0] + first), s2 = _mm512_load_ps(cascade.state[1] + first);
+        auto lane = _mm512_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f, 8.f, 9.f, 10.f, 11.f, 12.f, 13.f, 14.f, 15.f);
+        auto rotate = _mm512_setr_epi32(15, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14);
+        auto y = _mm512_setzero_ps();
+        for (int t = 0; t < num_samples + lanes - 1; t++)
+        {
+            auto input = t < num_samples ? data[t] : 0.f;
+            auto x = _mm512_mask_mov_ps(_mm512_permutexvar_ps(rotate, y), 1, _mm512_set1_ps(input));
+            y = _mm512_add_ps(_mm512_mul_ps(b0, x), s1);
+            auto next_s1 = _mm512_add_ps(_mm512_sub_ps(_mm512_mul_ps(b1, x), _mm512_mul_ps(a1, y)), s2);
+            auto next_s2 = _mm512_sub_ps(_mm512_mul_ps(b2, x), _mm512_mul_ps(a2, y));
+            if (t >= lanes - 1 && t < num_samples)
+            {
+                s1 = next_s1;
+                s2 = next_s2;
+            }
+            else
+            {
+                auto active = (__mmask16)(_mm512_cmp_ps_mask(lane, _mm512_set1_ps((float)t), _CMP_LE_OQ)
+                    & _mm512_cmp_ps_mask(lane, _mm512_set1_ps((float)(t - num_samples)), _CMP_GT_OQ));
+                s1 = _mm512_mask_mov_ps(s1, active, next_s1);
+                s2 = _mm512_mask_mov_ps(s2, active, next_s2);
+            }
+            if (t >= lanes - 1)
+            {
+                auto high = _mm512_extractf32x4_ps(y, 3);
+                data[t - (lanes - 1)] = _mm_cvtss_f32(_mm_shuffle_ps(high, high, _MM_SHUFFLE(3, 3, 3, 3)));
+            }
+        }
+        _mm512_store_ps(cascade.state[0] + first, s1);
+        _mm512_store_ps(cascade.state[1] + first, s2);
+    }
+
+    FDD_TARGET("avx512f") void cascade_avx512(float* data, int num_samples, Biquad_Cascade& cascade)
+    {
+        if (cascade.num_sections < min_pipelined_sections)
+            return cascade_scalar(data, num_samples, cascade);
+        if (cascade.num_sections <= 4)
+            return cascade_group_sse2(data, num_samples, cascade, 0);
+        if (cascade.num_sections <= 8)
+            return cascade_group_avx2(data, num_samples, cascade, 0);
+        cascade_group_avx512(data, num_samples, cascade, 0);
+    }
+
+    const Dsp_Kernels avx512_kernels{ Path_AVX512, subtract_avx512, add_avx512, pack_24_avx512, unpack_24_avx512, cascade_avx512 };
+#endif
+
+#if FDD_NEON
+    //==============================================================================
+    void subtract_neon(float* cut, const float* data, int num_samples)
+    {
+        int i = 0;
+        for (; i + 4 <= num_samples; i += 4)
+            vst1q_f32(cut + i, vsubq_f32(vld1q_f32(cut + i), vld1q_f32(data + i)));
+        subtract_scalar(cut + i, data + i, num_samples - i);
+    }
+
+    void add_neon(float* data, const float* cut, int num_samples)
+    {
+        int i = 0;
+        for (; i + 4 <= num_samples; i += 4)
+            vst1q_f32(data + i, vaddq_f32(vld1q_f32(data + i), vld1q_f32(cut + i)));
+        add_scalar(data + i, cut + i, num_samples - i);
+    }
+
+    void pack_24_neon(std::uint8_t* bytes, const float* source, int num_samples)
+    {
+        static const std::uint8_t shuffle_indices[16] = { 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, 255, 255, 255, 255 };
+        auto shuffle = vld1q_u8(shuffle_indices);
+        auto low = vdupq_n_f32(-packed_max), high = vdupq_n_f32(packed_max);
+        std::uint8_t lane[16];
+        int i = 0;
+        for (; i + 4 <= num_samples; i += 4)
+        {
+            auto x = vminq_f32(vmaxq_f32(vmulq_n_f32(vld1q_f32(source + i), packed_scale), low), high);
+            auto values = vreinterpretq_u8_s32(vcvtnq_s32_f32(x));
+            vst1q_u8(lane, vqtbl1q_u8(values, shuffle));
+            std::memcpy(bytes + 3 * i, lane, 12);
+        }
+        pack_24_scalar(bytes + 3 * i, source + i, num_samples - i);
+    }
+
+    void unpack_24_neon(float* destination, const std::uint8_t* bytes, int num_samples)
+    {
+        static const std::uint8_t spread_indices[16] = { 255, 0, 1, 2, 255, 3, 4, 5, 255, 6, 7, 8, 255, 9, 10, 11 };
+        auto spread = vld1q_u8(spread_indices);
+        std::uint8_t lane[16] = {};
+        int i = 0;
+        for (; i + 4 <= num_samples; i += 4)
+        {
+            std::memcpy(lane, bytes + 3 * i, 12);
+            auto values = vshrq_n_s32(vreinterpretq_s32_u8(vqtbl1q_u8(vld1q_u8(lane), spread)), 8);
+            vst1q_f32(destination + i, vmulq_n_f32(vcvtq_f32_s32(values), 1.f / packed_scale));
+        }
+        unpack_24_scalar(destination + i, bytes + 3 * i, num_samples - i);
+    }
+
+    void cascade_group_neon(float* data, int num_samples, Biquad_Cascade& cascade, int first)
+    {
+        constexpr int lanes = 4;
+        static const float lane_indices[4] = { 0.f, 1.f, 2.f, 3.f };
+        auto& c = cascade.coefficients;
+        auto b0 = vld1q_f32(c[0] + first), b1 = vld1q_f32(c[1] + first), b2 = vld1q_f32(c[2] + first);
+        auto a1 = vld1q_f32(c[3] + first), a2 = vld1q_f32(c[4] + first);
+        auto s1 = vld1q_f32(cascade.state[0] + first), s2 = vld1q_f32(cascade.state[1] + first);
+        auto lane = vld1q_f32(lane_indices);
+        auto y = vdupq_n_f32(0.f);
+        for (int t = 0; t < num_samples + lanes - 1; t++)
+        {
+            auto input = t < num_samples ? data[t] : 0.f;
+            auto x = vextq_f32(vdupq_n_f32(input), y, 3);
+            y = vaddq_f32(vmulq_f32(b0, x), s1);
+            auto next_s1 = vaddq_f32(vsubq_f32(vmulq_f32(b1, x), vmulq_f32(a1, y)), s2);
+            auto next_s2 = vsubq_f32(vmulq_f32(b2, x), vmulq_f32(a2, y));
+            if (t >= lanes - 1 && t < num_samples)
+            {
+                s1 = next_s1;
+                s2 = next_s2;
+            }
+            else
+            {
+                auto active = vandq_u32(vcleq_f32(lane, vdupq_n_f32((float)t)), vcgtq_f32(lane, vdupq_n_f32((float)(t - num_samples))));
+                s1 = vbslq_f32(active, next_s1, s1);
+                s2 = vbslq_f32(active, next_s2, s2);
+            }
+            if (t >= lanes - 1)
+                data[t - (lanes - 1)] = vgetq_lane_f32(y, 3);
+        }
+        vst1q_f32(cascade.state[0] + first, s1);
+        vst1q_f32(cascade.state[1] + first, s2);
+    }
+
+    void cascade_neon(float* data, int num_samples, Biquad_Cascade& cascade)
+    {
+        if (cascade.num_sections < min_pipelined_sections)
+            return cascade_scalar(data, num_samples, cascade);
+        for (int first = 0; first < cascade.num_sections; first += 4)
+            cascade_group_neon(data, num_samples, cascade, first);
+    }
+
+    const Dsp_Kernels neon_kernels{ Path_NEON, subtract_neon, add_neon, pack_24_neon, unpack_24_neon, cascade_neon };
+#endif
+
+    Cpu_Path parse_cpu_path(const juce::String& name)
+    {
+        for (auto path : { Path_Scalar, Path_SSE2, Path_AVX2, Path_AVX512, Path_NEON })
+        {
+            if (name.equalsIgnoreCase(get_cpu_path_name(path)))
+                return path;
+        }
+        return Path_Auto;
+    }
+}
+
+bool is_cpu_path_supported(Cpu_Path path)
+{
+    switch (path)
+    {
+#if FDD_X86
+    case Path_SSE2: return juce::SystemStats::hasSSE2();
+    case Path_AVX2: return juce::SystemStats::hasAVX2();
+    case Path_AVX512: return juce::SystemStats::hasAVX512F();
+#endif
+#if FDD_NEON
+    case Path_NEON: return juce::SystemStats::hasNeon();
+#endif
+    case Path_Scalar: return true;
+    default: return false;
+    }
+}
+
+const char* get_cpu_path_name(Cpu_Path path)
+{
+    switch (path)
+    {
+    case Path_Scalar: return "scalar";
+    case Path_SSE2: return "sse2";
+    case Path_AVX2: return "avx2";
+    case Path_AVX512: return "avx512";
+    case Path_NEON: return "neon";
+    default: return "auto";
+    }
+}
+
+void set_cpu_path_override(Cpu_Path path)
+{
+    cpu_path_override = path;
+}
+
+const Dsp_Kernels& get_dsp_kernels(Cpu_Path path)
+{
+    if (!is_cpu_path_supported(path))
+        return scalar_kernels;
+
+    switch (path)
+    {
+#if FDD_X86
+    case Path_SSE2: return sse2_kernels;
+    case Path_AVX2: return avx2_kernels;
+    case Path_AVX512: return avx512_kernels;
+#endif
+#if FDD_NEON
+    case Path_NEON: return neon_kernels;
+#endif
+    default: return scalar_kernels;
+    }
+}
+
+const Dsp_Kernels& select_dsp_kernels()
+{
+    auto path = (Cpu_Path)cpu_path_override.load();
+    if (path == Path_Auto)
+        path = parse_cpu_path(juce::SystemStats::getEnvironmentVariable("FDD_CPU_PATH", {}));
+
+    if (path != Path_Auto && is_cpu_path_supported(path))
+        return get_dsp_kernels(path);
+
+    for (auto candidate : { Path_AVX512, Path_AVX2, Path_SSE2, Path_NEON })
+    {
+        if (is_cpu_path_supported(candidate))
+            return get_dsp_kernels(candidate);
+    }
+    return scalar_kernels;
+}
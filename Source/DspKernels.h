@@ -0,0 +1,79 @@
+/*
+  ==============================================================================
+
+    Inner loops of the split and delay paths, built once per instruction set.
+    The best set the CPU supports is picked at prepareToPlay; FDD_CPU_PATH
+    (scalar, sse2, avx2, avx512, neon) or set_cpu_path_override() forces one.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <cstdint>
+
+enum Cpu_Path {
+    Path_Auto,
+    Path_Scalar,
+    Path_SSE2,
+    Path_AVX2,
+    Path_AVX512,
+    Path_NEON
+};
+
+// 24 bit samples keep 12 dB of headroom above full scale so that
+// intermediate bands above 0 dBFS are not clipped.
+constexpr float packed_scale = 2097152.f; // 2^21
+constexpr float packed_max = 8388607.f;   // 2^23 - 1
+
+// Serial second order sections, transposed direct form II like juce::dsp::IIR.
+// The SIMD kernels give every lane its own section and run the lanes one
+// sample apart, so a cascade takes about as long as a single section.
+constexpr int max_cascade_sections = 16;
+
+struct Biquad_Cascade {
+    // b0 b1 b2 a1 a2 normalised by a0, then the two state values; one column
+    // per section. Columns from num_sections on have to stay pass-through.
+    alignas(64) float coefficients[5][max_cascade_sections];
+    alignas(64) float state[2][max_cascade_sections];
+    int num_sections = 0;
+
+    void clear()
+    {
+        for (int s = 0; s < max_cascade_sections; s++)
+        {
+            coefficients[0][s] = 1.f;
+            coefficients[1][s] = coefficients[2][s] = coefficients[3][s] = coefficients[4][s] = 0.f;
+            state[0][s] = state[1][s] = 0.f;
+        }
+        num_sections = 0;
+    }
+
+    void reset()
+    {
+        for (int s = 0; s < max_cascade_sections; s++)
+            state[0][s] = state[1][s] = 0.f;
+    }
+};
+
+struct Dsp_Kernels {
+    Cpu_Path path;
+    void (*subtract)(float* cut, const float* data, int num_samples); // cut -= data
+    void (*add)(float* data, const float* cut, int num_samples);      // data += cut
+    void (*pack_24)(std::uint8_t* bytes, const float* source, int num_samples);
+    void (*unpack_24)(float* destination, const std::uint8_t* bytes, int num_samples);
+    void (*cascade)(float* data, int num_samples, Biquad_Cascade& cascade); // in place
+};
+
+bool is_cpu_path_supported(Cpu_Path path);
+const char* get_cpu_path_name(Cpu_Path path);
+
+// Path_Auto clears the override; an unsupported path falls back to auto.
+void set_cpu_path_override(Cpu_Path path);
+
+// Exact kernels for a supported path, the scalar ones otherwise.
+const Dsp_Kernels& get_dsp_kernels(Cpu_Path path);
+
+// Override, then FDD_CPU_PATH, then the fastest supported path.
+const Dsp_Kernels& select_dsp_kernels();
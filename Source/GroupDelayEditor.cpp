@@ -0,0 +1,187 @@
+/*
+  ==============================================================================
+
+    Lets the user draw the group delay curve used by the allpass mode.
+    Click to add or drag a point, double click a point to remove it. A drag
+    only reaches the processor (and the fitter) when the mouse is released,
+    and a curve loaded with a state replaces the points on screen.
+    The grid and curve are drawn into an image that is only redrawn when
+    the size or the curve changes, and at most once per display frame.
+
+  ==============================================================================
+*/
+
+#include "GroupDelayEditor.h"
+
+Group_Delay_Editor::Group_Delay_Editor(FreqencyDependentDelayerAudioProcessor& p)
+    : audio_processor(p)
+{
+    reload_curve();
+}
+
+void Group_Delay_Editor::paint(juce::Graphics& g)
+{
+    // the layer is drawn at the display scale, so the blit maps pixel to pixel
+    if (layer_dirty || layer_scale != juce::Component::getApproximateScaleFactorForComponent(this))
+        render_layer();
+    g.drawImage(layer, getLocalBounds().toFloat());
+}
+
+void Group_Delay_Editor::resized()
+{
+    layer_dirty = true;
+}
+
+void Group_Delay_Editor::on_vblank()
+{
+    // a loaded state waits for a running drag, which mouseUp() then drops
+    if (dragged_point < 0 && audio_processor.get_group_delay_curve_version() != curve_version)
+        reload_curve();
+    if (layer_dirty)
+        repaint();
+}
+
+void Group_Delay_Editor::push_curve()
+{
+    audio_processor.set_group_delay_curve(points);
+    curve_version = audio_processor.get_group_delay_curve_version();
+}
+
+void Group_Delay_Editor::reload_curve()
+{
+    curve_version = audio_processor.get_group_delay_curve_version();
+    points = audio_processor.get_group_delay_curve();
+    layer_dirty = true;
+}
+
+void Group_Delay_Editor::render_layer()
+{
+    layer_scale = juce::Component::getApproximateScaleFactorForComponent(this);
+    layer_dirty = false;
+    if (getWidth() <= 0 || getHeight() <= 0)
+        return;
+
+    layer = juce::Image(juce::Image::RGB, juce::roundToInt(getWidth() * layer_scale), juce::roundToInt(getHeight() * layer_scale), false);
+    juce::Graphics g(layer);
+    g.addTransform(juce::AffineTransform::scale(layer_scale));
+
+    auto bounds = getLocalBounds().toFloat();
+    g.setColour(juce::Colours::black);
+    g.fillRect(bounds);
+
+    g.setColour(juce::Colours::darkgrey);
+    for (float frequency : { 100.f, 1000.f, 10000.f })
+    {
+        g.drawVerticalLine((int)frequency_to_x(frequency), bounds.getY(), bounds.getBottom());
+    }
+    for (float delay_ms = 5.f; delay_ms < max_curve_delay_ms; delay_ms += 5.f)
+    {
+        g.drawHorizontalLine((int)delay_to_y(delay_ms), bounds.getX(), bounds.getRight());
+    }
+
+    auto sorted_points = points;
+    std::sort(sorted_points.begin(), sorted_points.end(),
+        [](const Curve_Point& a, const Curve_Point& b) { return a.frequency < b.frequency; });
+
+    if (!sorted_points.empty())
+    {
+        juce::Path curve;
+        curve.startNewSubPath(bounds.getX(), delay_to_y(sorted_points.front().delay_ms));
+        for (auto& point : sorted_points)
+        {
+            curve.lineTo(frequency_to_x(point.frequency), delay_to_y(point.delay_ms));
+        }
+        curve.lineTo(bounds.getRight(), delay_to_y(sorted_points.back().delay_ms));
+        g.setColour(juce::Colours::white);
+        g.strokePath(curve, juce::PathStrokeType(2.f));
+    }
+
+    g.setColour(juce::Colours::orange);
+    for (auto& point : sorted_points)
+    {
+        g.fillEllipse(frequency_to_x(point.frequency) - 4.f, delay_to_y(point.delay_ms) - 4.f, 8.f, 8.f);
+    }
+}
+
+void Group_Delay_Editor::mouseDown(const juce::MouseEvent& event)
+{
+    drag_start_version = audio_processor.get_group_delay_curve_version();
+    dragged_point = find_point(event.position);
+    if (dragged_point < 0)
+    {
+        points.push_back({});
+        dragged_point = (int)points.size() - 1;
+    }
+    move_point(dragged_point, event.position);
+}
+
+void Group_Delay_Editor::mouseDrag(const juce::MouseEvent& event)
+{
+    if (dragged_point >= 0)
+        move_point(dragged_point, event.position);
+}
+
+void Group_Delay_Editor::mouseUp(const juce::MouseEvent&)
+{
+    if (dragged_point < 0)
+        return;
+    dragged_point = -1;
+
+    // a state loaded during the drag wins over the dragged point
+    if (audio_processor.get_group_delay_curve_version() != drag_start_version)
+        reload_curve();
+    else
+        push_curve();
+}
+
+void Group_Delay_Editor::mouseDoubleClick(const juce::MouseEvent& event)
+{
+    auto index = find_point(event.position);
+    if (index < 0)
+        return;
+
+    points.erase(points.begin() + index);
+    dragged_point = -1; // the second click picked the point up, it is gone now
+    push_curve();
+    layer_dirty = true;
+}
+
+float Group_Delay_Editor::frequency_to_x(float frequency) const
+{
+    return juce::mapFromLog10(frequency, min_frequency, max_frequency) * getWidth();
+}
+
+float Group_Delay_Editor::x_to_frequency(float x) const
+{
+    return juce::mapToLog10(juce::jlimit(0.f, 1.f, x / getWidth()), min_frequency, max_frequency);
+}
+
+float Group_Delay_Editor::delay_to_y(float delay_ms) const
+{
+    return juce::jmap(delay_ms, 0.f, max_curve_delay_ms, (float)getHeight(), 0.f);
+}
+
+float Group_Delay_Editor::y_to_delay(float y) const
+{
+    return juce::jlimit(0.f, max_curve_delay_ms, juce::jmap(y, (float)getHeight(), 0.f, 0.f, max_curve_delay_ms));
+}
+
+int Group_Delay_Editor::find_point(juce::Point<float> position) const
+{
+    for (int i = 0; i < (int)points.size(); i++)
+    {
+        juce::Point<float> point(frequency_to_x(points[i].frequency), delay_to_y(points[i].delay_ms));
+        if (point.getDistanceFrom(position) < 6.f)
+            return i;
+    }
+    return -1;
+}
+
+void Group_Delay_Editor::move_point(int index, juce::Point<float> position)
+{
+    points[index].frequency = x_to_frequency(position.x);
+    points[index].delay_ms = y_to_delay(position.y);
+    // the refit and the state write wait for mouseUp(), the redraw for the next
+    // frame, so fast drags neither refit nor paint on every event
+    layer_dirty = true;
+}
@@ -0,0 +1,58 @@
+/*
+  ==============================================================================
+
+    Lets the user draw the group delay curve used by the allpass mode.
+    Click to add or drag a point, double click a point to remove it. A drag
+    only reaches the processor (and the fitter) when the mouse is released,
+    and a curve loaded with a state replaces the points on screen.
+    The grid and curve are drawn into an image that is only redrawn when
+    the size or the curve changes, and at most once per display frame.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+
+class Group_Delay_Editor : public juce::Component {
+public:
+    Group_Delay_Editor(FreqencyDependentDelayerAudioProcessor& p);
+
+    void paint(juce::Graphics& g) override;
+    void resized() override;
+    void mouseDown(const juce::MouseEvent& event) override;
+    void mouseDrag(const juce::MouseEvent& event) override;
+    void mouseUp(const juce::MouseEvent& event) override;
+    void mouseDoubleClick(const juce::MouseEvent& event) override;
+
+private:
+    static constexpr float min_frequency = 20.f, max_frequency = 20000.f;
+    static constexpr float max_curve_delay_ms = 20.f;
+
+    float frequency_to_x(float frequency) const;
+    float x_to_frequency(float x) const;
+    float delay_to_y(float delay_ms) const;
+    float y_to_delay(float y) const;
+    int find_point(juce::Point<float> position) const;
+    void move_point(int index, juce::Point<float> position);
+
+    void render_layer();
+    void on_vblank();
+    void push_curve();
+    void reload_curve();
+
+    FreqencyDependentDelayerAudioProcessor& audio_processor;
+    std::vector<Curve_Point> points;
+    int dragged_point = -1;
+    int curve_version = 0;     // the processor's curve the points were last in step with
+    int drag_start_version = 0;
+
+    juce::Image layer;
+    float layer_scale = 1.f;
+    bool layer_dirty = true;
+    juce::VBlankAttachment vblank{ this, [this] { on_vblank(); } };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Group_Delay_Editor)
+};
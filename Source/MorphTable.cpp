@@ -0,0 +1,134 @@
+/*
+  ==============================================================================
+
+    Precomputed filter coefficients along the path between two snapshots,
+    so the morph control only interpolates between neighbouring entries.
+
+  ==============================================================================
+*/
+
+#include "MorphTable.h"
+
+namespace
+{
+    void section_values(const juce::ReferenceCountedArray<juce::dsp::IIR::Coefficients<float>>& coefficients, int section, float* values)
+    {
+        if (section >= coefficients.size())
+        {
+            // unused stages morph from/to a pass-through biquad
+            values[0] = 1.f;
+            for (int k = 1; k < biquad_values; k++)
+                values[k] = 0.f;
+            return;
+        }
+
+        auto* raw = coefficients[section]->getRawCoefficients();
+        for (int k = 0; k < biquad_values; k++)
+            values[k] = raw[k];
+    }
+
+    void fill_band(Morph_Sections& sections, bool high_pass, float frequency_a, float frequency_b,
+        Slope slope_a, Slope slope_b, float t, double sample_rate)
+    {
+        // frequencies move on a log scale, like the sliders
+        auto frequency = frequency_a * std::pow(frequency_b / frequency_a, t);
+        auto design = [&](Slope slope) {
+            if (high_pass)
+                return juce::dsp::FilterDesign<float>::designIIRHighpassHighOrderButterworthMethod(frequency, sample_rate, 2 * (slope + 1));
+            return juce::dsp::FilterDesign<float>::designIIRLowpassHighOrderButterworthMethod(frequency, sample_rate, 2 * (slope + 1));
+        };
+        auto coefficients_a = design(slope_a);
+        auto coefficients_b = slope_b == slope_a ? coefficients_a : design(slope_b);
+
+        for (int section = 0; section < max_pass_sections; section++)
+        {
+            float values_a[biquad_values], values_b[biquad_values];
+            section_values(coefficients_a, section, values_a);
+            section_values(coefficients_b, section, values_b);
+            for (int k = 0; k < biquad_values; k++)
+                sections[section * biquad_values + k] = values_a[k] + t * (values_b[k] - values_a[k]);
+        }
+    }
+}
+
+void build_morph_table(Morph_Table& table, const Chain_Settings& a, const Chain_Settings& b, double sample_rate)
+{
+    table.low_pass_sections = juce::jmax(a.low_pass_slope, b.low_pass_slope) + 1;
+    table.high_pass_sections = juce::jmax(a.high_pass_slope, b.high_pass_slope) + 1;
+    table.delay_a_ms = a.delay_ms;
+    table.delay_b_ms = b.delay_ms;
+
+    for (int i = 0; i < morph_table_size; i++)
+    {
+        auto t = (float)i / (morph_table_size - 1);
+        auto& entry = table.entries[i];
+        fill_band(entry.low_pass, false, a.low_pass_freq, b.low_pass_freq, a.low_pass_slope, b.low_pass_slope, t, sample_rate);
+        fill_band(entry.high_pass, true, a.high_pass_freq, b.high_pass_freq, a.high_pass_slope, b.high_pass_slope, t, sample_rate);
+    }
+    table.valid = true;
+}
+
+//==============================================================================
+Morph_Builder::Morph_Builder() : juce::Thread("Morph Builder")
+{
+}
+
+Morph_Builder::~Morph_Builder()
+{
+    signalThreadShouldExit();
+    notify();
+    stopThread(2000);
+}
+
+void Morph_Builder::set_snapshots(const Chain_Settings& a, const Chain_Settings& b)
+{
+    {
+        const juce::ScopedLock lock(request_lock);
+        requested_a = a;
+        requested_b = b;
+        has_snapshots = true;
+    }
+    if (!isThreadRunning())
+        startThread();
+    notify();
+}
+
+void Morph_Builder::set_sample_rate(double sample_rate)
+{
+    {
+        const juce::ScopedLock lock(request_lock);
+        if (sample_rate == requested_sample_rate)
+            return; // the last result still holds
+        requested_sample_rate = sample_rate;
+    }
+    notify();
+}
+
+void Morph_Builder::run()
+{
+    while (!threadShouldExit())
+    {
+        wait(-1);
+        if (threadShouldExit())
+            return;
+
+        Chain_Settings a, b;
+        double sample_rate;
+        {
+            const juce::ScopedLock lock(request_lock);
+            if (!has_snapshots)
+                continue;
+            a = requested_a;
+            b = requested_b;
+            sample_rate = requested_sample_rate;
+        }
+        if (sample_rate <= 0)
+            continue;
+
+        build_morph_table(building, a, b, sample_rate);
+
+        juce::SpinLock::ScopedLockType lock(result_lock);
+        result = building;
+        result_ready = true;
+    }
+}
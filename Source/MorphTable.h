@@ -0,0 +1,71 @@
+/*
+  ==============================================================================
+
+    Precomputed filter coefficients along the path between two snapshots,
+    so the morph control only interpolates between neighbouring entries.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include "ChainSettings.h"
+
+constexpr int morph_table_size = 64;
+constexpr int biquad_values = 5; // b0, b1, b2, a1, a2 normalised by a0
+
+using Morph_Sections = std::array<float, max_pass_sections * biquad_values>;
+
+struct Morph_Entry {
+    Morph_Sections low_pass, high_pass;
+};
+
+struct Morph_Table {
+    std::array<Morph_Entry, morph_table_size> entries;
+    int low_pass_sections{ 1 }, high_pass_sections{ 1 };
+    float delay_a_ms{ 0.f }, delay_b_ms{ 0.f };
+    bool valid{ false };
+};
+
+// Linear blends of stable biquads stay stable, so every point of the
+// table (and every interpolation between entries) is a stable filter.
+void build_morph_table(Morph_Table& table, const Chain_Settings& a, const Chain_Settings& b, double sample_rate);
+
+class Morph_Builder : private juce::Thread {
+public:
+    Morph_Builder();
+    ~Morph_Builder() override;
+
+    // Message thread. The thread starts with the first pair of snapshots.
+    void set_snapshots(const Chain_Settings& a, const Chain_Settings& b);
+    void set_sample_rate(double sample_rate);
+    bool is_running() const { return isThreadRunning(); }
+
+    // Audio thread: calls install(const Morph_Table&) if a new table is waiting.
+    template<typename Install>
+    bool consume(Install&& install) {
+        if (!result_ready.load())
+            return false;
+        juce::SpinLock::ScopedTryLockType lock(result_lock);
+        if (!lock.isLocked())
+            return false;
+        install(result);
+        result_ready = false;
+        return true;
+    };
+
+private:
+    void run() override;
+
+    juce::CriticalSection request_lock;
+    Chain_Settings requested_a, requested_b;
+    bool has_snapshots{ false };
+    double requested_sample_rate{ 0. };
+
+    juce::SpinLock result_lock;
+    Morph_Table result, building;
+    std::atomic<bool> result_ready{ false };
+};
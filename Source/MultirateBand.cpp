@@ -0,0 +1,300 @@
+/*
+  ==============================================================================
+
+    Runs the filtered band of the split at a decimated rate. Polyphase
+    half-band stages bring the band down by 2^stages, the band filters and
+    the delay run there, and the result is interpolated back and recombined
+    with a latency aligned copy of the input.
+
+  ==============================================================================
+*/
+
+#include "MultirateBand.h"
+
+namespace
+{
+    // A 4K - 1 tap half-band has its centre tap at an odd index, so the even
+    // taps form one polyphase branch and the other is the centre tap alone.
+    constexpr int half_band_centre = half_band_branch_taps - 1;
+    constexpr int half_band_taps = 2 * half_band_branch_taps - 1;
+
+    // Kaiser windowed sinc, about 80 dB of stopband rejection.
+    std::array<float, half_band_branch_taps> design_branch_taps()
+    {
+        std::array<float, half_band_taps> window;
+        juce::dsp::WindowingFunction<float>::fillWindowingTables(window.data(), (size_t)half_band_taps,
+            juce::dsp::WindowingFunction<float>::kaiser, false, 8.f);
+
+        std::array<float, half_band_branch_taps> taps;
+        float sum = 0.f;
+        for (int m = 0; m < half_band_branch_taps; m++)
+        {
+            auto x = juce::MathConstants<double>::pi * (2 * m - half_band_centre) / 2;
+            taps[m] = (float)(0.5 * std::sin(x) / x) * window[2 * m];
+            sum += taps[m];
+        }
+        // the branch has to contribute exactly half of the DC gain
+        for (auto& tap : taps)
+            tap *= 0.5f / sum;
+        return taps;
+    }
+
+    const std::array<float, half_band_branch_taps>& branch_taps()
+    {
+        static const auto taps = design_branch_taps();
+        return taps;
+    }
+
+    int round_trip_latency(int num_stages)
+    {
+        // every stage delays by the centre tap twice, at its own input rate
+        return 2 * half_band_centre * ((1 << num_stages) - 1);
+    }
+}
+
+//==============================================================================
+void Half_Band_Decimator::reset()
+{
+    even_history.fill(0.f);
+    odd_history.fill(0.f);
+    even_position = odd_position = 0;
+    odd_phase = false;
+}
+
+bool Half_Band_Decimator::push(float x, float& y)
+{
+    if (odd_phase)
+    {
+        odd_history[odd_position] = x;
+        odd_position = (odd_position + 1) % (int)odd_history.size();
+        odd_phase = false;
+        return false;
+    }
+
+    even_position = (even_position == 0 ? half_band_branch_taps : even_position) - 1;
+    even_history[even_position] = even_history[even_position + half_band_branch_taps] = x;
+
+    auto& taps = branch_taps();
+    auto* history = even_history.data() + even_position; // newest first
+    float sum = 0.5f * odd_history[odd_position];       // oldest odd sample sits at the centre tap
+    for (int m = 0; m < half_band_branch_taps; m++)
+        sum += taps[m] * history[m];
+
+    y = sum;
+    odd_phase = true;
+    return true;
+}
+
+void Half_Band_Interpolator::reset()
+{
+    history.fill(0.f);
+    position = 0;
+}
+
+void Half_Band_Interpolator::push(float x, float* y_pair)
+{
+    position = (position == 0 ? half_band_branch_taps : position) - 1;
+    history[position] = history[position + half_band_branch_taps] = x;
+
+    auto& taps = branch_taps();
+    auto* newest = history.data() + position;
+    float sum = 0.f;
+    for (int m = 0; m < half_band_branch_taps; m++)
+        sum += taps[m] * newest[m];
+
+    // zero stuffing halves the level, the factor 2 restores it
+    y_pair[0] = 2.f * sum;
+    y_pair[1] = newest[half_band_branch_taps / 2 - 1];
+}
+
+//==============================================================================
+int Multirate_Band::get_max_stages(double sample_rate)
+{
+    int stages = 0;
+    while (stages < max_multirate_stages && sample_rate / (2 << stages) >= 2000.)
+        stages++;
+    return stages;
+}
+
+int Multirate_Band::choose_stages(double sample_rate, float low_pass_freq)
+{
+    auto max = get_max_stages(sample_rate);
+    int stages = juce::jmin(1, max);
+    while (stages < max && sample_rate / (2 << stages) >= 32. * low_pass_freq)
+        stages++;
+    return stages;
+}
+
+int Multirate_Band::get_latency_samples(double sample_rate)
+{
+    // padded to the deepest decimation, so moving the crossover never changes the latency;
+    // the last term covers a block that ends partway through a band sample
+    auto max = get_max_stages(sample_rate);
+    return round_trip_latency(max) + (1 << max) - 1;
+}
+
+void Multirate_Band::prepare(double new_sample_rate, int max_block_size, int max_delay_samples, const Dsp_Kernels& new_kernels)
+{
+    sample_rate = new_sample_rate;
+    kernels = &new_kernels;
+    max_stages = get_max_stages(sample_rate);
+    latency = get_latency_samples(sample_rate);
+    branch_taps(); // designs the taps here rather than on the audio thread
+
+    band.assign((size_t)max_block_size + 1, 0.f);
+    undelayed_band.assign((size_t)max_block_size + 1, 0.f);
+    output_fifo.assign((size_t)(latency + max_block_size + (1 << max_multirate_stages)), 0.f);
+    dry_delay.prepare(latency, max_block_size, new_kernels);
+    dry_delay.set_delay(latency);
+    // the band never runs above half the rate unless the rate allows no decimation at all
+    auto min_stages = juce::jmin(1, max_stages);
+    band_delay.prepare((max_delay_samples >> min_stages) + 1, (max_block_size >> min_stages) + 1, new_kernels);
+
+    auto current = num_stages < 0 ? max_stages : juce::jmin(num_stages, max_stages);
+    num_stages = -1;
+    set_stages(current);
+}
+
+void Multirate_Band::reset()
+{
+    for (auto& decimator : decimators)
+        decimator.reset();
+    for (auto& interpolator : interpolators)
+        interpolator.reset();
+
+    std::fill(output_fifo.begin(), output_fifo.end(), 0.f);
+    fifo_read = 0;
+    fifo_available = fifo_write = latency - round_trip_latency(juce::jmax(0, num_stages));
+    dry_delay.reset();
+    band_delay.reset();
+    last_delayed = 0.f;
+    rest_line_current = false;
+}
+
+void Multirate_Band::set_stages(int new_num_stages)
+{
+    new_num_stages = juce::jlimit(0, max_stages, new_num_stages);
+    if (new_num_stages == num_stages)
+        return;
+
+    num_stages = new_num_stages;
+    reset();
+    set_delay(signed_delay);
+}
+
+void Multirate_Band::set_delay(int signed_delay_samples, int fade_samples)
+{
+    signed_delay = signed_delay_samples;
+    band_delayed = signed_delay <= 0;
+    if (!band_delayed)
+    {
+        band_delay.set_delay(0); // a sign change jumps, the rest line starts from silence anyway
+        fraction = 0.f;
+        return;
+    }
+
+    auto factor = 1 << juce::jmax(0, num_stages);
+    auto band_samples = -signed_delay / factor;
+    band_delay.set_delay(band_samples, fade_samples / factor);
+    fraction = (float)(-signed_delay - band_samples * factor) / factor;
+}
+
+int Multirate_Band::decimate(const float* input, int num_samples)
+{
+    int count = 0;
+    for (int i = 0; i < num_samples; i++)
+    {
+        auto value = input[i];
+        int stage = 0;
+        while (stage < num_stages && decimators[stage].push(value, value))
+            stage++;
+        if (stage == num_stages)
+            band[count++] = value;
+    }
+    return count;
+}
+
+void Multirate_Band::expand(int stage, float value, float*& output)
+{
+    float pair[2];
+    interpolators[stage].push(value, pair);
+    if (stage == 0)
+    {
+        *output++ = pair[0];
+        *output++ = pair[1];
+        return;
+    }
+    expand(stage - 1, pair[0], output);
+    expand(stage - 1, pair[1], output);
+}
+
+void Multirate_Band::interpolate(const float* band_samples, int num_band_samples)
+{
+    std::array<float, 1 << max_multirate_stages> expanded;
+    auto capacity = (int)output_fifo.size();
+    for (int i = 0; i < num_band_samples; i++)
+    {
+        auto* end = expanded.data();
+        if (num_stages == 0)
+            *end++ = band_samples[i];
+        else
+            expand(num_stages - 1, band_samples[i], end);
+
+        for (auto* sample = expanded.data(); sample < end; sample++)
+        {
+            output_fifo[fifo_write] = *sample;
+            fifo_write = (fifo_write + 1) % capacity;
+        }
+        fifo_available += (int)(end - expanded.data());
+    }
+}
+
+void Multirate_Band::read_output(float* destination, int num_samples)
+{
+    jassert(fifo_available >= num_samples);
+    auto capacity = (int)output_fifo.size();
+    int first = juce::jmin(num_samples, capacity - fifo_read);
+    juce::FloatVectorOperations::copy(destination, output_fifo.data() + fifo_read, first);
+    juce::FloatVectorOperations::copy(destination + first, output_fifo.data(), num_samples - first);
+    fifo_read = (fifo_read + num_samples) % capacity;
+    fifo_available -= num_samples;
+}
+
+void Multirate_Band::recombine(float* data, float* scratch, int num_samples, int num_band_samples, Delay_Line& rest_delay)
+{
+    juce::FloatVectorOperations::copy(scratch, data, num_samples);
+    dry_delay.process(scratch, num_samples);
+
+    if (band_delayed)
+    {
+        // output = dry + delayed band - band, so only the difference is interpolated
+        juce::FloatVectorOperations::copy(undelayed_band.data(), band.data(), num_band_samples);
+        band_delay.process(band.data(), num_band_samples);
+        for (int i = 0; i < num_band_samples; i++)
+        {
+            // the band sits far below the band rate, linear interpolation is plenty
+            auto delayed = band[i];
+            band[i] = delayed + fraction * (last_delayed - delayed);
+            last_delayed = delayed;
+        }
+        kernels->subtract(band.data(), undelayed_band.data(), num_band_samples);
+        interpolate(band.data(), num_band_samples);
+        read_output(data, num_samples);
+        kernels->add(data, scratch, num_samples);
+        rest_line_current = false;
+        return;
+    }
+
+    // at delay 0 the band line only records, so a switch back finds its history in place
+    band_delay.process(band.data(), num_band_samples);
+    if (!rest_line_current)
+    {
+        rest_delay.reset();
+        rest_line_current = true;
+    }
+    interpolate(band.data(), num_band_samples);
+    read_output(data, num_samples);
+    kernels->subtract(scratch, data, num_samples);
+    rest_delay.process(scratch, num_samples);
+    kernels->add(data, scratch, num_samples);
+}
@@ -0,0 +1,108 @@
+/*
+  ==============================================================================
+
+    Runs the filtered band of the split at a decimated rate. Polyphase
+    half-band stages bring the band down by 2^stages, the band filters and
+    the delay run there, and the result is interpolated back and recombined
+    with a latency aligned copy of the input.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <vector>
+#include "DelayLine.h"
+
+constexpr int max_multirate_stages = 4;
+constexpr int half_band_branch_taps = 16; // 2K taps of a 4K - 1 tap half-band, K = 8
+
+// Both polyphase branches of a 2x half-band: the even taps and a pure delay.
+class Half_Band_Decimator {
+public:
+    void reset();
+    // Returns true when x completed a pair and y holds a new output sample.
+    bool push(float x, float& y);
+
+private:
+    std::array<float, 2 * half_band_branch_taps> even_history{}; // doubled so the taps read one contiguous run
+    std::array<float, half_band_branch_taps / 2> odd_history{};
+    int even_position = 0, odd_position = 0;
+    bool odd_phase = false;
+};
+
+class Half_Band_Interpolator {
+public:
+    void reset();
+    void push(float x, float* y_pair);
+
+private:
+    std::array<float, 2 * half_band_branch_taps> history{};
+    int position = 0;
+};
+
+class Multirate_Band {
+public:
+    // Deepest decimation a sample rate allows; the reported latency is fixed per rate.
+    static int get_max_stages(double sample_rate);
+    // Band rate stays at least 32 times above the low pass frequency, never below 1 stage.
+    static int choose_stages(double sample_rate, float low_pass_freq);
+    static int get_latency_samples(double sample_rate);
+
+    // The band's own delay line runs at the band rate, so it only needs
+    // max_delay_samples >> stages; the full rate line is left to the rest.
+    void prepare(double sample_rate, int max_block_size, int max_delay_samples, const Dsp_Kernels& kernels);
+    void reset();
+    // Reallocates the band delay line, not for the audio thread.
+    void set_storage(Delay_Storage storage) { band_delay.set_storage(storage); }
+
+    // Restarts the band when the factor changes; the band filters then need a redesign.
+    void set_stages(int new_num_stages);
+    int get_stages() const { return num_stages; }
+    double get_band_sample_rate() const { return sample_rate / (1 << num_stages); }
+
+    // Signed like the Delay parameter, in full rate samples: negative delays the band,
+    // positive the rest. The band is delayed at the decimated rate in the band's own
+    // line, the rest at full rate in the line passed to process(), set to get_rest_delay().
+    // fade_samples > 0 fades the band line over to the new delay, see Delay_Line.
+    void set_delay(int signed_delay_samples, int fade_samples = 0);
+    int get_rest_delay() const { return band_delayed ? 0 : signed_delay; }
+
+    template<typename Chain>
+    void process(float* data, float* scratch, int num_samples, Chain& band_filter, Delay_Line& rest_delay)
+    {
+        int num_band_samples = decimate(data, num_samples);
+        float* band_channels[] = { band.data() };
+        juce::dsp::AudioBlock<float> band_block(band_channels, 1, (size_t)num_band_samples);
+        juce::dsp::ProcessContextReplacing<float> band_context(band_block);
+        band_filter.process(band_context);
+        recombine(data, scratch, num_samples, num_band_samples, rest_delay);
+    }
+
+private:
+    int decimate(const float* input, int num_samples);
+    void interpolate(const float* band_samples, int num_band_samples);
+    void expand(int stage, float value, float*& output);
+    void read_output(float* destination, int num_samples);
+    void recombine(float* data, float* scratch, int num_samples, int num_band_samples, Delay_Line& rest_delay);
+
+    double sample_rate = 44100.;
+    int num_stages = -1, max_stages = 0, latency = 0;
+    const Dsp_Kernels* kernels = &get_dsp_kernels(Path_Scalar);
+
+    std::array<Half_Band_Decimator, max_multirate_stages> decimators;
+    std::array<Half_Band_Interpolator, max_multirate_stages> interpolators;
+    std::vector<float> band, undelayed_band;
+
+    // interpolated band, primed so that a block can always be read in full
+    std::vector<float> output_fifo;
+    int fifo_read = 0, fifo_write = 0, fifo_available = 0;
+
+    Delay_Line dry_delay, band_delay;
+    int signed_delay = 0;
+    float fraction = 0.f, last_delayed = 0.f;
+    bool band_delayed = true;
+    bool rest_line_current = false; // the rest line only runs for positive delays
+};
@@ -0,0 +1,56 @@
+/*
+  ==============================================================================
+
+    Parameter changes that must not call listeners where they happen: state
+    loads and parameter events on the audio thread. The value is set right
+    away, so the processor reads it on its next block; the listeners (the
+    editor's attachments, the storage switch, and the format wrapper, which
+    passes it on to the host) hear about it later on the message thread.
+
+  ==============================================================================
+*/
+
+#include "ParameterSync.h"
+
+Parameter_Sync::Parameter_Sync(juce::AudioProcessor& owner)
+    : processor(owner)
+{
+    auto num_parameters = (size_t)processor.getParameters().size();
+    pending = std::make_unique<std::atomic<bool>[]>(num_parameters);
+    for (size_t i = 0; i < num_parameters; i++)
+        pending[i] = false;
+    startTimerHz(30);
+}
+
+Parameter_Sync::~Parameter_Sync()
+{
+    stopTimer();
+}
+
+void Parameter_Sync::set(juce::RangedAudioParameter& parameter, float value)
+{
+    // setValue() is only public on the base
+    static_cast<juce::AudioProcessorParameter&>(parameter).setValue(parameter.convertTo0to1(value));
+    pending[(size_t)parameter.getParameterIndex()] = true;
+    any_pending = true;
+}
+
+void Parameter_Sync::set(juce::AudioProcessorValueTreeState& apvts, const Chain_Settings& settings)
+{
+    visit_chain_settings(settings, [this, &apvts](juce::StringRef id, float value) { set(*apvts.getParameter(id), value); });
+}
+
+void Parameter_Sync::timerCallback()
+{
+    if (!any_pending.exchange(false))
+        return;
+
+    // every listener hears of these, the wrapper's too, so the host is notified of
+    // values it set or restored itself as well, once and from the message thread
+    auto& parameters = processor.getParameters();
+    for (int i = 0; i < parameters.size(); i++)
+    {
+        if (pending[(size_t)i].exchange(false))
+            parameters[i]->sendValueChangedMessageToListeners(parameters[i]->getValue());
+    }
+}
@@ -0,0 +1,35 @@
+/*
+  ==============================================================================
+
+    Parameter changes that must not call listeners where they happen: state
+    loads and parameter events on the audio thread. The value is set right
+    away, so the processor reads it on its next block; the listeners (the
+    editor's attachments, the storage switch, and the format wrapper, which
+    passes it on to the host) hear about it later on the message thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <memory>
+#include "ChainSettings.h"
+
+class Parameter_Sync : private juce::Timer {
+public:
+    explicit Parameter_Sync(juce::AudioProcessor& processor);
+    ~Parameter_Sync() override;
+
+    // Any thread, lock free. The value is in the parameter's own range.
+    void set(juce::RangedAudioParameter& parameter, float value);
+    void set(juce::AudioProcessorValueTreeState& apvts, const Chain_Settings& settings);
+
+private:
+    void timerCallback() override;
+
+    juce::AudioProcessor& processor;
+    std::unique_ptr<std::atomic<bool>[]> pending; // per parameter index
+    std::atomic<bool> any_pending{ false };
+};
@@ -8,15 +8,41 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include <complex>
+#include <numeric>
+
+namespace
+{
+    const juce::StringArray filter_parameters{ "Low Pass Freq", "High Pass Freq", "Low Pass Slope V2", "High Pass Slope V2" };
+
+    // Response of the used sections of a pass design at `frequency`.
+    std::complex<double> get_pass_response(const Pass_Design& design, Slope slope, double frequency, double sample_rate)
+    {
+        auto w = juce::MathConstants<double>::twoPi * frequency / sample_rate;
+        auto z1 = std::polar(1., -w), z2 = z1 * z1;
+        std::complex<double> response = 1.;
+        for (int i = 0; i <= slope; i++)
+        {
+            auto& c = design[i];
+            response *= ((double)c[0] + (double)c[1] * z1 + (double)c[2] * z2) / ((double)c[3] + (double)c[4] * z1 + (double)c[5] * z2);
+        }
+        return response;
+    }
+}
 
 //==============================================================================
 FreqencyDependentDelayerAudioProcessorEditor::FreqencyDependentDelayerAudioProcessorEditor(FreqencyDependentDelayerAudioProcessor& p)
     : AudioProcessorEditor(&p), audioProcessor(p),
     low_pass_freq_slider_attachment(audioProcessor.apvts, "Low Pass Freq", low_pass_freq_slider),
     high_pass_freq_slider_attachment(audioProcessor.apvts, "High Pass Freq", high_pass_freq_slider),
-    low_pass_slope_slider_attachment(audioProcessor.apvts, "Low Pass Slope", low_pass_slope_slider),
-    high_pass_slope_slider_attachment(audioProcessor.apvts, "High Pass Slope", high_pass_slope_slider),
-    delay_slider_attachment(audioProcessor.apvts, "Delay", delay_slider)
+    low_pass_slope_slider_attachment(audioProcessor.apvts, "Low Pass Slope V2", low_pass_slope_slider),
+    high_pass_slope_slider_attachment(audioProcessor.apvts, "High Pass Slope V2", high_pass_slope_slider),
+    delay_slider_attachment(audioProcessor.apvts, "Delay", delay_slider),
+    group_delay_editor(audioProcessor),
+    mode_box_attachment(audioProcessor.apvts, "Mode", mode_box),
+    morph_button_attachment(audioProcessor.apvts, "Morph Enabled", morph_button),
+    morph_slider_attachment(audioProcessor.apvts, "Morph", morph_slider),
+    estimation_box_attachment(audioProcessor.apvts, "Delay Estimation", estimation_box)
 {
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
@@ -28,6 +54,8 @@ FreqencyDependentDelayerAudioProcessorEditor::FreqencyDependentDelayerAudioProce
     {
         auto& slider = *(comps[i]);
         slider.setTextValueSuffix(units[i]);
+        // redrawn from the image when a neighbour repaints, the knob only when its value moves
+        slider.setBufferedToImage(true);
         auto& label = *(labels[i]);
         addAndMakeVisible(slider);
         addAndMakeVisible(label);
@@ -35,23 +63,66 @@ FreqencyDependentDelayerAudioProcessorEditor::FreqencyDependentDelayerAudioProce
         label.setJustificationType(juce::Justification::Flags::centred);
         label.attachToComponent(&slider, true);
     }
+    addAndMakeVisible(response_curve);
+    addAndMakeVisible(group_delay_editor);
+    addAndMakeVisible(mode_box);
+
+    store_a_button.onClick = [this] { audioProcessor.store_snapshot(0); };
+    store_b_button.onClick = [this] { audioProcessor.store_snapshot(1); };
+    for (auto* component : std::initializer_list<juce::Component*>{ &store_a_button, &store_b_button, &morph_button, &morph_slider, &estimation_box, &estimate_button })
+    {
+        addAndMakeVisible(component);
+    }
 
+#if FDD_ENABLE_PROFILING
+    addAndMakeVisible(cpu_load_readout);
+#endif
+
+    auto frame_log_path = juce::SystemStats::getEnvironmentVariable("FDD_FRAME_LOG", {});
+    if (juce::File::isAbsolutePath(frame_log_path))
+    {
+        frame_log = juce::File(frame_log_path);
+        frame_ms.reserve(1 << 16);
+    }
+
+    setOpaque(true);
     setSize (600, 400);
 }
 
 FreqencyDependentDelayerAudioProcessorEditor::~FreqencyDependentDelayerAudioProcessorEditor()
 {
+    write_frame_log();
 }
 
 //==============================================================================
 void FreqencyDependentDelayerAudioProcessorEditor::paint (juce::Graphics& g)
 {
+    paint_start_ticks = juce::Time::getHighResolutionTicks();
     // (Our component is opaque, so we must completely fill the background with a solid colour)
     g.fillAll (getLookAndFeel().findColour (juce::ResizableWindow::backgroundColourId));
+}
 
-    g.setColour (juce::Colours::white);
-    g.setFont (15.0f);
-    //    g.drawFittedText ("Hello World!", getLocalBounds(), juce::Justification::centred, 1);
+void FreqencyDependentDelayerAudioProcessorEditor::paintOverChildren (juce::Graphics&)
+{
+    auto end_ticks = juce::Time::getHighResolutionTicks();
+#if FDD_ENABLE_PROFILING
+    audioProcessor.profiler.record(Stage_Paint, -1, paint_start_ticks, end_ticks);
+#endif
+    if (frame_log != juce::File() && frame_ms.size() < frame_ms.capacity())
+        frame_ms.push_back((float)(1000. * juce::Time::highResolutionTicksToSeconds(end_ticks - paint_start_ticks)));
+}
+
+void FreqencyDependentDelayerAudioProcessorEditor::write_frame_log()
+{
+    if (frame_ms.empty())
+        return;
+
+    std::sort(frame_ms.begin(), frame_ms.end());
+    auto mean = std::accumulate(frame_ms.begin(), frame_ms.end(), 0.) / frame_ms.size();
+    auto percentile = [this](double p) { return frame_ms[(size_t)(p * (frame_ms.size() - 1))]; };
+    frame_log.appendText(juce::String((int)frame_ms.size()) + " frames, mean " + juce::String(mean, 3)
+        + " ms, p50 " + juce::String(percentile(0.5), 3) + " ms, p99 " + juce::String(percentile(0.99), 3)
+        + " ms, max " + juce::String(frame_ms.back(), 3) + " ms\n");
 }
 
 void FreqencyDependentDelayerAudioProcessorEditor::resized()
@@ -60,6 +131,20 @@ void FreqencyDependentDelayerAudioProcessorEditor::resized()
     // subcomponents in your editor..
     auto bounds = getLocalBounds();
     auto response_area = bounds.removeFromTop(bounds.getHeight() * 0.33);
+    auto snapshot_area = response_area.removeFromRight(120);
+    mode_box.setBounds(snapshot_area.removeFromTop(24));
+    auto store_area = snapshot_area.removeFromTop(24);
+    store_a_button.setBounds(store_area.removeFromLeft(store_area.getWidth() / 2));
+    store_b_button.setBounds(store_area);
+    morph_button.setBounds(snapshot_area.removeFromTop(24));
+    morph_slider.setBounds(snapshot_area.removeFromTop(24));
+    estimation_box.setBounds(snapshot_area.removeFromTop(24));
+    estimate_button.setBounds(snapshot_area.removeFromTop(24));
+#if FDD_ENABLE_PROFILING
+    cpu_load_readout.setBounds(snapshot_area.removeFromTop(24));
+#endif
+    response_curve.setBounds(response_area.removeFromLeft(response_area.getWidth() / 2).reduced(4));
+    group_delay_editor.setBounds(response_area.reduced(4));
 
     auto high_pass_area = bounds.removeFromLeft(bounds.getWidth() * 0.33);
     auto high_pass_labels_area = high_pass_area.removeFromTop(high_pass_area.getHeight() * 0.2);
@@ -127,4 +212,156 @@ std::vector<std::string> FreqencyDependentDelayerAudioProcessorEditor::get_comps
         "High Pass Slope",
         "Delay"
     };
-}
\ No newline at end of file
+}
+//==============================================================================
+Delay_Estimate_Button::Delay_Estimate_Button(FreqencyDependentDelayerAudioProcessor& p) : processor(p)
+{
+    onClick = [this]
+    {
+        auto* delay = processor.apvts.getParameter("Delay");
+        delay->beginChangeGesture();
+        delay->setValueNotifyingHost(delay->convertTo0to1(estimate_ms));
+        delay->endChangeGesture();
+    };
+    setEnabled(false);
+    startTimerHz(4);
+}
+
+void Delay_Estimate_Button::timerCallback()
+{
+    auto has_estimate = processor.delay_estimator.get_delay_ms(estimate_ms);
+    setEnabled(has_estimate);
+    setButtonText(has_estimate ? "Use " + juce::String(estimate_ms, 1) + " ms" : "No estimate");
+}
+
+//==============================================================================
+Response_Curve::Response_Curve(FreqencyDependentDelayerAudioProcessor& p) : processor(p)
+{
+    for (auto& id : filter_parameters)
+        processor.apvts.addParameterListener(id, this);
+    setOpaque(true);
+}
+
+Response_Curve::~Response_Curve()
+{
+    for (auto& id : filter_parameters)
+        processor.apvts.removeParameterListener(id, this);
+}
+
+void Response_Curve::parameterChanged(const juce::String&, float)
+{
+    layer_dirty = true;
+}
+
+void Response_Curve::resized()
+{
+    layer_dirty = true;
+}
+
+void Response_Curve::paint(juce::Graphics& g)
+{
+    // drawn at the display scale like the curve editor's layer, so the blit maps pixel to pixel
+    if (layer_dirty || layer_scale != juce::Component::getApproximateScaleFactorForComponent(this))
+        render_layer();
+    g.drawImage(layer, getLocalBounds().toFloat());
+}
+
+void Response_Curve::render_layer()
+{
+    layer_scale = juce::Component::getApproximateScaleFactorForComponent(this);
+    layer_dirty = false;
+    if (getWidth() <= 0 || getHeight() <= 0)
+        return;
+
+    layer = juce::Image(juce::Image::RGB, juce::roundToInt(getWidth() * layer_scale), juce::roundToInt(getHeight() * layer_scale), false);
+    juce::Graphics g(layer);
+    g.addTransform(juce::AffineTransform::scale(layer_scale));
+
+    auto bounds = getLocalBounds().toFloat();
+    auto width = bounds.getWidth(), height = bounds.getHeight();
+    auto frequency_to_x = [&](double frequency) { return (float)juce::mapFromLog10(frequency, (double)min_frequency, (double)max_frequency) * width; };
+    auto db_to_y = [&](double db) { return juce::jmap((float)juce::jlimit((double)min_db, (double)max_db, db), min_db, max_db, height, 0.f); };
+
+    g.setColour(juce::Colours::black);
+    g.fillRect(bounds);
+    g.setColour(juce::Colours::darkgrey);
+    for (float frequency : { 100.f, 1000.f, 10000.f })
+        g.drawVerticalLine((int)frequency_to_x(frequency), 0.f, height);
+    for (float db = -12.f; db > min_db; db -= 12.f)
+        g.drawHorizontalLine((int)db_to_y(db), 0.f, width);
+
+    // the designs for the parameters, at the rate the processor runs (or a usual one before it is prepared)
+    auto settings = get_chain_settings(processor.apvts);
+    auto sample_rate = processor.getSampleRate() > 0 ? processor.getSampleRate() : 48000.;
+    auto low_pass = design_low_pass(settings.low_pass_freq, sample_rate, settings.low_pass_slope);
+    auto high_pass = design_high_pass(settings.high_pass_freq, sample_rate, settings.high_pass_slope);
+
+    juce::Path filtered, rest;
+    for (int x = 0; x < (int)width; x++)
+    {
+        auto frequency = juce::mapToLog10((double)x / width, (double)min_frequency, (double)max_frequency);
+        frequency = juce::jmin(frequency, 0.49 * sample_rate);
+        auto response = get_pass_response(low_pass, settings.low_pass_slope, frequency, sample_rate)
+            * get_pass_response(high_pass, settings.high_pass_slope, frequency, sample_rate);
+        // the rest is the input minus the filtered band
+        auto filtered_y = db_to_y(juce::Decibels::gainToDecibels(std::abs(response), -100.));
+        auto rest_y = db_to_y(juce::Decibels::gainToDecibels(std::abs(1. - response), -100.));
+        if (x == 0)
+        {
+            filtered.startNewSubPath((float)x, filtered_y);
+            rest.startNewSubPath((float)x, rest_y);
+        }
+        else
+        {
+            filtered.lineTo((float)x, filtered_y);
+            rest.lineTo((float)x, rest_y);
+        }
+    }
+    g.setColour(juce::Colours::grey);
+    g.strokePath(rest, juce::PathStrokeType(1.5f));
+    g.setColour(juce::Colours::white);
+    g.strokePath(filtered, juce::PathStrokeType(2.f));
+}
+
+#if FDD_ENABLE_PROFILING
+//==============================================================================
+Cpu_Load_Readout::Cpu_Load_Readout(Stage_Profiler& p) : profiler(p)
+{
+    setJustificationType(juce::Justification::centred);
+    startTimerHz(4);
+}
+
+void Cpu_Load_Readout::timerCallback()
+{
+    setText("CPU " + juce::String(100.f * profiler.get_cpu_load(), 1) + " % " + profiler.get_kernels_name(), juce::dontSendNotification);
+}
+
+void Cpu_Load_Readout::mouseDown(const juce::MouseEvent&)
+{
+    juce::PopupMenu menu;
+    for (int stage = 0; stage < num_profile_stages; stage++)
+    {
+        auto summary = profiler.get_summary((Profile_Stage)stage);
+        if (summary.count == 0)
+            continue;
+        menu.addItem(juce::String(Stage_Profiler::get_stage_name((Profile_Stage)stage))
+            + ": mean " + juce::String(summary.mean_us, 1) + " us, p50 < " + juce::String(summary.p50_us, 1)
+            + " us, p99 < " + juce::String(summary.p99_us, 1) + " us", false, false, nullptr);
+    }
+    menu.addSeparator();
+    menu.addItem("Write Chrome trace...", [this]
+        {
+            trace_chooser = std::make_unique<juce::FileChooser>("Write trace",
+                juce::File::getSpecialLocation(juce::File::userDesktopDirectory).getChildFile("fdd_trace.json"), "*.json");
+            trace_chooser->launchAsync(juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::warnAboutOverwriting,
+                [this](const juce::FileChooser& chooser)
+                {
+                    auto file = chooser.getResult();
+                    if (file != juce::File())
+                        profiler.write_trace(file);
+                });
+        });
+    menu.addItem("Reset counters", [this] { profiler.reset(); });
+    menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(this));
+}
+#endif
@@ -9,7 +9,10 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include <atomic>
+#include <vector>
 #include "PluginProcessor.h"
+#include "GroupDelayEditor.h"
 
 struct Custom_Rotary_Slider : juce::Slider {
     Custom_Rotary_Slider() : juce::Slider(juce::Slider::SliderStyle::RotaryHorizontalVerticalDrag,
@@ -19,6 +22,70 @@ struct Custom_Rotary_Slider : juce::Slider {
     }
 };
 
+struct Mode_Combo_Box : juce::ComboBox {
+    Mode_Combo_Box()
+    {
+        // items must exist before the attachment selects one
+        addItemList({ "Split", "Allpass", "Spectral", "Multirate" }, 1);
+    }
+};
+
+struct Estimation_Combo_Box : juce::ComboBox {
+    Estimation_Combo_Box()
+    {
+        addItemList({ "Estimate Off", "Suggest", "Apply" }, 1);
+    }
+};
+
+// Shows the sidechain delay estimate; a click sets Delay to it.
+struct Delay_Estimate_Button : juce::TextButton, private juce::Timer {
+    explicit Delay_Estimate_Button(FreqencyDependentDelayerAudioProcessor& p);
+
+private:
+    void timerCallback() override;
+
+    FreqencyDependentDelayerAudioProcessor& processor;
+    float estimate_ms{ 0.f };
+};
+
+// Magnitude of the filtered band and of the rest, drawn into an image that is only
+// redrawn when a filter parameter, the size or the display scale changes.
+struct Response_Curve : juce::Component, private juce::AudioProcessorValueTreeState::Listener {
+    explicit Response_Curve(FreqencyDependentDelayerAudioProcessor& p);
+    ~Response_Curve() override;
+
+    void paint(juce::Graphics& g) override;
+    void resized() override;
+
+private:
+    static constexpr float min_frequency = 20.f, max_frequency = 20000.f;
+    static constexpr float min_db = -48.f, max_db = 6.f;
+
+    // any thread, automation included; the next display frame redraws
+    void parameterChanged(const juce::String& parameter_id, float new_value) override;
+    void render_layer();
+
+    FreqencyDependentDelayerAudioProcessor& processor;
+    juce::Image layer;
+    float layer_scale = 1.f;
+    std::atomic<bool> layer_dirty{ true };
+    juce::VBlankAttachment vblank{ this, [this] { if (layer_dirty) repaint(); } };
+};
+
+#if FDD_ENABLE_PROFILING
+// CPU load of the recent blocks; click for the per-stage timings and the trace export.
+struct Cpu_Load_Readout : juce::Label, private juce::Timer {
+    explicit Cpu_Load_Readout(Stage_Profiler& p);
+    void mouseDown(const juce::MouseEvent& event) override;
+
+private:
+    void timerCallback() override;
+
+    Stage_Profiler& profiler;
+    std::unique_ptr<juce::FileChooser> trace_chooser;
+};
+#endif
+
 //==============================================================================
 /**
 */
@@ -31,6 +98,7 @@ public:
     //==============================================================================
     void paint (juce::Graphics&) override;
     void resized() override;
+    void paintOverChildren (juce::Graphics&) override;
 
 private:
     // This reference is provided as a quick way for your editor to
@@ -58,12 +126,35 @@ private:
         high_pass_slope_slider_attachment,
         delay_slider_attachment;
 
+    Response_Curve response_curve{ audioProcessor };
+    Group_Delay_Editor group_delay_editor;
+    Mode_Combo_Box mode_box;
+    APVTS::ComboBoxAttachment mode_box_attachment;
+
+    juce::TextButton store_a_button{ "Store A" }, store_b_button{ "Store B" };
+    juce::ToggleButton morph_button{ "Morph" };
+    juce::Slider morph_slider{ juce::Slider::SliderStyle::LinearHorizontal, juce::Slider::TextEntryBoxPosition::NoTextBox };
+    APVTS::ButtonAttachment morph_button_attachment;
+    Attachment morph_slider_attachment;
+
+    Estimation_Combo_Box estimation_box;
+    APVTS::ComboBoxAttachment estimation_box_attachment;
+    Delay_Estimate_Button estimate_button{ audioProcessor };
+
+#if FDD_ENABLE_PROFILING
+    Cpu_Load_Readout cpu_load_readout{ audioProcessor.profiler };
+#endif
+    // paint() to paintOverChildren() spans every component drawn in a frame. FDD_FRAME_LOG
+    // names a file that gets a summary of the frame times when the editor closes, in any build.
+    juce::int64 paint_start_ticks = 0;
+    juce::File frame_log;
+    std::vector<float> frame_ms;
+    void write_frame_log();
+
     std::vector<juce::Slider*> get_comps();
     std::vector<juce::Label*> get_comps_labels();
     std::vector<std::string> get_comps_units();
     std::vector<std::string> get_comps_texts();
 
-    Pass_Chain pass_chain;
-
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FreqencyDependentDelayerAudioProcessorEditor)
 };
@@ -16,12 +16,42 @@ FreqencyDependentDelayerAudioProcessor::FreqencyDependentDelayerAudioProcessor()
                      #if ! JucePlugin_IsMidiEffect
                       #if ! JucePlugin_IsSynth
                        .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
+                       .withInput  ("Sidechain", juce::AudioChannelSet::stereo(), false)
                       #endif
                        .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
                      #endif
                        )
 #endif
 {
+    auto make_preset = [](const char* name, float high_pass_freq, Slope slope, float delay_ms) {
+        Preset preset;
+        preset.name = name;
+        preset.settings.high_pass_freq = high_pass_freq;
+        preset.settings.high_pass_slope = slope;
+        preset.settings.delay_ms = delay_ms;
+        return preset;
+    };
+    presets = {
+        make_preset("Default", 20.f, Slope_12, 0.f),
+        make_preset("Sub 80 Hz, Low +2 ms", 80.f, Slope_24, 2.f),
+        make_preset("Sub 120 Hz, Low +4 ms", 120.f, Slope_24, 4.f),
+        make_preset("Mid 300 Hz, Low +10 ms", 300.f, Slope_48, 10.f),
+        make_preset("High 2 kHz, High +2 ms", 2000.f, Slope_24, -2.f),
+        make_preset("Long Throw 1 s", 20.f, Slope_12, 1000.f)
+    };
+
+    send_group_delay_curve(get_group_delay_curve());
+#if FDD_ENABLE_PROFILING
+    split_engine.profiler = &profiler;
+#endif
+#if FDD_CLAP
+    // the wrapper derives the CLAP ids from the parameter ids the same way
+    for (auto* parameter : getParameters())
+    {
+        if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(parameter))
+            clap_parameters.push_back({ (clap_id)ranged->getParameterID().hashCode(), ranged });
+    }
+#endif
 }
 
 FreqencyDependentDelayerAudioProcessor::~FreqencyDependentDelayerAudioProcessor()
@@ -68,22 +98,30 @@ double FreqencyDependentDelayerAudioProcessor::getTailLengthSeconds() const
 
 int FreqencyDependentDelayerAudioProcessor::getNumPrograms()
 {
-    return 1;   // NB: some hosts don't cope very well if you tell them there are 0 programs,
-                // so this should be at least 1, even if you're not really implementing programs.
+    return (int)presets.size();
 }
 
 int FreqencyDependentDelayerAudioProcessor::getCurrentProgram()
 {
-    return 0;
+    return current_program;
 }
 
 void FreqencyDependentDelayerAudioProcessor::setCurrentProgram (int index)
 {
+    if (index < 0 || index >= (int)presets.size())
+        return;
+
+    current_program = index;
+    // parameters first, so the audio thread sees matching values once it takes the preset
+    set_chain_settings(apvts, presets[index].settings);
+    pending_preset = index;
 }
 
 const juce::String FreqencyDependentDelayerAudioProcessor::getProgramName (int index)
 {
-    return {};
+    if (index < 0 || index >= (int)presets.size())
+        return {};
+    return presets[index].name;
 }
 
 void FreqencyDependentDelayerAudioProcessor::changeProgramName (int index, const juce::String& newName)
@@ -95,29 +133,75 @@ void FreqencyDependentDelayerAudioProcessor::prepareToPlay (double sampleRate, i
 {
     // Use this method as the place to do any pre-playback
     // initialisation that you need..
-    int n_channels = 2;
+    int n_channels = juce::jmax(getMainBusNumInputChannels(), getMainBusNumOutputChannels());
+    // hosts prepare on every transport start too; designs made for this rate stay
+    auto rate_changed = sampleRate != prepared_sample_rate;
+    prepared_sample_rate = sampleRate;
+
+    auto chain_settings = get_chain_settings(apvts);
+    split_engine.set_storage(chain_settings.delay_storage);
+    split_engine.prepare(sampleRate, n_channels, samplesPerBlock);
+    auto& dsp_kernels = split_engine.get_kernels();
+#if FDD_ENABLE_PROFILING
+    profiler.set_kernels_name(get_cpu_path_name(dsp_kernels.path));
+#endif
 
-    cut_buffer.setSize(n_channels, samplesPerBlock);
-    for (int ch = 0; ch < n_channels; ch++)
+    if (rate_changed)
+        num_allpass_sections = 0; // pass-through until the fitter delivers for the new rate
+    auto num_prepared_cascades = allpass_cascades.size();
+    allpass_cascades.resize(n_channels);
+    for (size_t ch = 0; ch < allpass_cascades.size(); ch++)
     {
-        shift_buffers.push_back({});
+        auto& cascade = allpass_cascades[ch];
+        if (num_allpass_sections == 0)
+            cascade.clear();
+        else if (ch >= num_prepared_cascades)
+            std::memcpy(cascade.coefficients, allpass_cascades[0].coefficients, sizeof(cascade.coefficients)); // a new channel joins the design
+        cascade.num_sections = num_allpass_sections;
+        cascade.reset();
     }
+    allpass_fitter.set_sample_rate(sampleRate);
 
-    juce::dsp::ProcessSpec spec;
-    spec.maximumBlockSize = samplesPerBlock;
-    spec.numChannels = 1;
-    spec.sampleRate = sampleRate;
-    pass_chain_mono.prepare(spec);
+    multirate_bands.resize(n_channels);
+    auto max_delay_samples = (int)std::ceil(sampleRate * max_delay_ms / 1000);
+    for (auto& band : multirate_bands)
+    {
+        band.set_storage(chain_settings.delay_storage);
+        band.prepare(sampleRate, samplesPerBlock, max_delay_samples, dsp_kernels);
+    }
 
-    auto chain_settings = get_chain_settings(apvts);
+    spectral_delay.prepare(sampleRate, n_channels);
+    spectral_delay.set_hop_index(chain_settings.hop_size_index);
+    setLatencySamples(get_mode_latency(chain_settings));
 
-    update_processing();
+    if (isNonRealtime())
+    {
+        start_channel_workers();
+    }
+#if FDD_CLAP
+    clap_channels.resize(n_channels);
+#endif
+
+    if (rate_changed)
+        design_presets(sampleRate);
+    morph_builder.set_sample_rate(sampleRate);
+    delay_estimator.prepare(sampleRate);
+    update_estimator_thread();
+    // the filters are designed by the first block, a host preparing several
+    // times in a row doesn't pay for designs it never plays
 }
 
 void FreqencyDependentDelayerAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
+#if FDD_ENABLE_PROFILING
+    auto trace_path = juce::SystemStats::getEnvironmentVariable("FDD_TRACE_FILE", {});
+    if (juce::File::isAbsolutePath(trace_path))
+    {
+        profiler.write_trace(juce::File(trace_path));
+    }
+#endif
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -127,18 +211,19 @@ bool FreqencyDependentDelayerAudioProcessor::isBusesLayoutSupported (const Buses
     juce::ignoreUnused (layouts);
     return true;
   #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    // Some plugin hosts, such as certain GarageBand versions, will only
-    // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // Every channel is processed independently, so any non-empty layout
+    // works (speaker alignment setups commonly run 16 or more channels).
+    if (layouts.getMainOutputChannelSet().isDisabled())
         return false;
 
     // This checks if the input layout matches the output layout
    #if ! JucePlugin_IsSynth
     if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
         return false;
+
+    // the sidechain only feeds the delay estimator, which reads its first channel
+    if (layouts.inputBuses.size() > 1 && layouts.getChannelSet(true, 1).size() > 2)
+        return false;
    #endif
 
     return true;
@@ -149,8 +234,15 @@ bool FreqencyDependentDelayerAudioProcessor::isBusesLayoutSupported (const Buses
 void FreqencyDependentDelayerAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
     juce::ScopedNoDenormals noDenormals;
-    auto totalNumInputChannels  = getTotalNumInputChannels();
-    auto totalNumOutputChannels = getTotalNumOutputChannels();
+    FDD_PROFILE_BLOCK(profiler, buffer.getNumSamples(), getSampleRate());
+    auto totalNumInputChannels  = getMainBusNumInputChannels();
+    auto totalNumOutputChannels = getMainBusNumOutputChannels();
+
+    // the hosts place the sidechain after the main inputs; the CLAP path passes it on its own
+    if (buffer.getNumChannels() > totalNumInputChannels && totalNumInputChannels > 0 && getChannelCountOfBus(true, 1) > 0)
+    {
+        push_sidechain(buffer.getReadPointer(0), buffer.getReadPointer(totalNumInputChannels), buffer.getNumSamples());
+    }
 
     // In case we have more outputs than inputs, this code clears any output
     // channels that didn't contain input data, (because these aren't
@@ -179,39 +271,50 @@ void FreqencyDependentDelayerAudioProcessor::processBlock (juce::AudioBuffer<flo
     DBG("Delay ms: ");
     DBG(chain_settings.delay_ms);
 
+    auto preset_index = pending_preset.exchange(-1);
+    if (preset_index >= 0 && preset_index < (int)preset_designs.size() && !apply_preset_design(preset_designs[preset_index]))
+    {
+        // a fade is still running, the preset goes with a later block unless a newer one came in
+        auto none = -1;
+        pending_preset.compare_exchange_strong(none, preset_index);
+    }
+    allpass_fitter.consume([this](const Allpass_Design& design) { update_allpass_cascades(design); });
+    morph_builder.consume([this](const Morph_Table& table) { morph_table = table; });
     update_processing();
-    juce::dsp::AudioBlock<float> block(buffer);
 
-    int num_requested_samples = buffer.getNumSamples();
-    for (int ch = 0; ch < buffer.getNumChannels(); ch++) // for soome reason people use ++ch?
+    int num_channels = juce::jmin(buffer.getNumChannels(), split_engine.get_num_channels());
+    auto latency = get_mode_latency(chain_settings);
+    if (latency != getLatencySamples())
     {
-        cut_buffer.copyFrom(ch, 0, buffer.getReadPointer(ch), num_requested_samples);
-        juce::dsp::ProcessContextReplacing<float> mono_context(block.getSingleChannelBlock(ch));
-        pass_chain_mono.process(mono_context);
-        auto* data_channel = buffer.getWritePointer(ch);
-        auto* cut_channel = cut_buffer.getWritePointer(ch);
-        for (int i = 0; i < num_requested_samples; i++)
-        {
-            cut_channel[i] -= data_channel[i]; // calculate rest of cut signal (opposite filtering)
-        }
+        setLatencySamples(latency);
+    }
 
-        auto& shift_buffer = shift_buffers[ch];
-        if (chain_settings.delay_ms < 0)
-        {
-            delay_signal(data_channel, num_requested_samples, shift_buffer);
-        }
-        else if (chain_settings.delay_ms > 0)
-        {
-            delay_signal(cut_channel, num_requested_samples, shift_buffer);
-        }
-        else { ; }
+    if (chain_settings.mode == Delay_Mode::Mode_Spectral)
+    {
+        // the STFT engine shares its frame timing across channels, keep it serial
+        FDD_PROFILE_BEGIN(profiler, -1);
+        spectral_delay.set_hop_index(chain_settings.hop_size_index);
+        spectral_delay.process(buffer, num_channels);
+        FDD_PROFILE_LAP(Stage_Spectral);
+        return;
+    }
+    if (chain_settings.mode == Delay_Mode::Mode_Allpass)
+    {
+        for_each_channel(num_channels, [this, &buffer](int ch) { process_allpass_channel(buffer, ch); });
+        return;
+    }
 
-        for (int i = 0; i < num_requested_samples; i++)
-        {
-            data_channel[i] += cut_channel[i];
-        }
+    if (chain_settings.mode == Delay_Mode::Mode_Multirate)
+    {
+        for_each_channel(num_channels, [this, &buffer](int ch) { process_multirate_channel(buffer, ch); });
+        return;
     }
 
+    for_each_channel(num_channels, [this, &buffer](int ch) {
+        split_engine.process_channel(buffer.getWritePointer(ch), ch, buffer.getNumSamples());
+    });
+    split_engine.end_block(buffer.getNumSamples());
+
     /*
     //
     // LR not arbitrary many channels
@@ -281,37 +384,244 @@ juce::AudioProcessorEditor* FreqencyDependentDelayerAudioProcessor::createEditor
 }
 
 //==============================================================================
+namespace
+{
+    // The slope choices grew from 12-48 to 12-96 dB/Oct. Under the old ids a host's
+    // normalised automation would land on other choices, so the longer lists have new ids.
+    const std::array<std::pair<const char*, const char*>, 2> renamed_parameters{ {
+        { "Low Pass Slope", "Low Pass Slope V2" },
+        { "High Pass Slope", "High Pass Slope V2" } } };
+
+    // Choice parameters store their index, which means the same under both ids.
+    void migrate_parameter_ids(juce::ValueTree& tree)
+    {
+        for (auto child : tree)
+        {
+            for (auto& [old_id, new_id] : renamed_parameters)
+            {
+                if (child.hasType("PARAM") && child.getProperty("id").toString() == old_id)
+                    child.setProperty("id", new_id, nullptr);
+            }
+        }
+    }
+}
+
 void FreqencyDependentDelayerAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
     // You should use this method to store your parameters in the memory block.
     // You could do that either as raw data, or use the XML or ValueTree classes
     // as intermediaries to make it easy to save and load complex data.
-    juce::MemoryOutputStream mos(destData, true);
-    apvts.state.writeToStream(mos);
+    write_compact_state(destData);
 }
 
 void FreqencyDependentDelayerAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
     // You should use this method to restore your parameters from this memory block,
     // whose contents will have been created by the getStateInformation() call.
+    // Filters are redesigned by the audio thread once it sees the new parameters.
+    if (read_compact_state(data, sizeInBytes))
+        return;
+
+    // sessions saved before the compact format stored the whole ValueTree
     auto tree = juce::ValueTree::readFromData(data, sizeInBytes);
     if (tree.isValid()) {
+        migrate_parameter_ids(tree);
         apvts.replaceState(tree);
-        update_processing();
+        send_group_delay_curve(get_group_delay_curve());
+    }
+}
+
+void FreqencyDependentDelayerAudioProcessor::write_compact_state(juce::MemoryBlock& dest_data)
+{
+    auto settings = get_chain_settings(apvts);
+    auto curve = get_group_delay_curve();
+
+    juce::MemoryOutputStream mos(dest_data, false);
+    mos.writeInt((int)compact_state_magic);
+    mos.writeShort((short)compact_state_version);
+    mos.writeFloat(settings.low_pass_freq);
+    mos.writeFloat(settings.high_pass_freq);
+    mos.writeFloat(settings.delay_ms);
+    mos.writeByte((char)settings.low_pass_slope);
+    mos.writeByte((char)settings.high_pass_slope);
+    mos.writeByte((char)settings.delay_storage);
+    mos.writeByte((char)settings.mode);
+    mos.writeByte((char)settings.hop_size_index);
+    mos.writeByte((char)current_program);
+    mos.writeShort((short)curve.size());
+    for (auto& point : curve)
+    {
+        mos.writeFloat(point.frequency);
+        mos.writeFloat(point.delay_ms);
+    }
+
+    // version 2: morph parameters and snapshots
+    mos.writeFloat(settings.morph);
+    mos.writeByte((char)settings.morph_enabled);
+    for (int i = 0; i < 2; i++)
+    {
+        auto& snapshot = snapshots[i];
+        mos.writeByte((char)snapshot_stored[i]);
+        mos.writeFloat(snapshot.low_pass_freq);
+        mos.writeFloat(snapshot.high_pass_freq);
+        mos.writeFloat(snapshot.delay_ms);
+        mos.writeByte((char)snapshot.low_pass_slope);
+        mos.writeByte((char)snapshot.high_pass_slope);
+    }
+
+    // version 3: delay estimation
+    mos.writeByte((char)settings.delay_estimation);
+}
+
+bool FreqencyDependentDelayerAudioProcessor::read_compact_state(const void* data, int size_in_bytes)
+{
+    // three floats, six bytes and the point count
+    constexpr int fixed_bytes = 3 * 4 + 6 + 2;
+    // version 2: morph and its switch, then two snapshots of a flag, three floats and two slopes
+    constexpr int morph_bytes = 4 + 1 + 2 * (1 + 3 * 4 + 2);
+    // version 3: delay estimation
+    constexpr int estimation_bytes = 1;
+
+    juce::MemoryInputStream mis(data, (size_t)juce::jmax(0, size_in_bytes), false);
+    if (size_in_bytes < 6 || (juce::uint32)mis.readInt() != compact_state_magic)
+        return false;
+
+    auto version = (int)mis.readShort();
+    if (version < 1 || version > compact_state_version)
+        return false;
+
+    if (mis.getNumBytesRemaining() < fixed_bytes)
+        return false;
+    Chain_Settings settings;
+    settings.low_pass_freq = mis.readFloat();
+    settings.high_pass_freq = mis.readFloat();
+    settings.delay_ms = mis.readFloat();
+    settings.low_pass_slope = static_cast<Slope>(mis.readByte());
+    settings.high_pass_slope = static_cast<Slope>(mis.readByte());
+    settings.delay_storage = static_cast<Delay_Storage>(mis.readByte());
+    settings.mode = static_cast<Delay_Mode>(mis.readByte());
+    settings.hop_size_index = mis.readByte();
+    auto program = (int)mis.readByte();
+
+    auto num_points = juce::jmax(0, (int)mis.readShort());
+    if (mis.getNumBytesRemaining() < (juce::int64)num_points * 2 * (juce::int64)sizeof(float))
+        return false;
+
+    std::vector<Curve_Point> curve((size_t)num_points);
+    for (auto& point : curve)
+    {
+        point.frequency = mis.readFloat();
+        point.delay_ms = mis.readFloat();
+    }
+
+    // nothing is taken over until the whole state has been read
+    auto loaded_snapshots = snapshots;
+    auto loaded_stored = snapshot_stored;
+    if (version >= 2)
+    {
+        if (mis.getNumBytesRemaining() < morph_bytes)
+            return false;
+        settings.morph = mis.readFloat();
+        settings.morph_enabled = mis.readByte() != 0;
+        auto read_slope = [&mis] { return static_cast<Slope>(juce::jlimit((int)Slope_12, (int)Slope_96, (int)mis.readByte())); };
+        for (int i = 0; i < 2; i++)
+        {
+            auto& snapshot = loaded_snapshots[i];
+            loaded_stored[i] = mis.readByte() != 0;
+            snapshot.low_pass_freq = mis.readFloat();
+            snapshot.high_pass_freq = mis.readFloat();
+            snapshot.delay_ms = mis.readFloat();
+            snapshot.low_pass_slope = read_slope();
+            snapshot.high_pass_slope = read_slope();
+        }
+    }
+    if (version >= 3)
+    {
+        if (mis.getNumBytesRemaining() < estimation_bytes)
+            return false;
+        settings.delay_estimation = static_cast<Estimation_Mode>(mis.readByte());
+    }
+
+    snapshots = loaded_snapshots;
+    snapshot_stored = loaded_stored;
+    if (version >= 2 && snapshot_stored[0] && snapshot_stored[1])
+        morph_builder.set_snapshots(snapshots[0], snapshots[1]);
+
+    current_program = juce::jlimit(0, juce::jmax(0, (int)presets.size() - 1), program);
+    // no listener runs while the host restores the state, they hear of it from the message thread
+    parameter_sync.set(apvts, settings);
+    set_group_delay_curve(curve);
+    return true;
+}
+
+namespace
+{
+    // The parameter's own value; Parameter_Sync changes it before the listeners hear of it.
+    float read_parameter(juce::AudioProcessorValueTreeState& apvts, juce::StringRef id)
+    {
+        auto* parameter = apvts.getParameter(id);
+        return parameter->convertFrom0to1(parameter->getValue());
     }
 }
 
 Chain_Settings get_chain_settings(juce::AudioProcessorValueTreeState& apvts)
 {
     Chain_Settings settings;
-    settings.low_pass_freq = apvts.getRawParameterValue("Low Pass Freq")->load();
-    settings.high_pass_freq = apvts.getRawParameterValue("High Pass Freq")->load();
-    settings.low_pass_slope = static_cast<Slope>(apvts.getRawParameterValue("Low Pass Slope")->load());
-    settings.high_pass_slope = static_cast<Slope>(apvts.getRawParameterValue("High Pass Slope")->load());
-    settings.delay_ms = apvts.getRawParameterValue("Delay")->load();
+    settings.low_pass_freq = read_parameter(apvts, "Low Pass Freq");
+    settings.high_pass_freq = read_parameter(apvts, "High Pass Freq");
+    settings.low_pass_slope = static_cast<Slope>(read_parameter(apvts, "Low Pass Slope V2"));
+    settings.high_pass_slope = static_cast<Slope>(read_parameter(apvts, "High Pass Slope V2"));
+    settings.delay_ms = read_parameter(apvts, "Delay");
+    settings.delay_storage = static_cast<Delay_Storage>(read_parameter(apvts, "Delay Storage"));
+    settings.mode = static_cast<Delay_Mode>(read_parameter(apvts, "Mode"));
+    settings.hop_size_index = static_cast<int>(read_parameter(apvts, "Hop Size"));
+    settings.morph = read_parameter(apvts, "Morph");
+    settings.morph_enabled = read_parameter(apvts, "Morph Enabled") > 0.5f;
+    settings.delay_estimation = static_cast<Estimation_Mode>(read_parameter(apvts, "Delay Estimation"));
     return settings;
 }
 
+void visit_chain_settings(const Chain_Settings& settings, const std::function<void(juce::StringRef, float)>& set)
+{
+    set("Low Pass Freq", settings.low_pass_freq);
+    set("High Pass Freq", settings.high_pass_freq);
+    set("Low Pass Slope V2", (float)settings.low_pass_slope);
+    set("High Pass Slope V2", (float)settings.high_pass_slope);
+    set("Delay", settings.delay_ms);
+    set("Delay Storage", (float)settings.delay_storage);
+    set("Mode", (float)settings.mode);
+    set("Hop Size", (float)settings.hop_size_index);
+    set("Morph", settings.morph);
+    set("Morph Enabled", settings.morph_enabled ? 1.f : 0.f);
+    set("Delay Estimation", (float)settings.delay_estimation);
+}
+
+void set_chain_settings(juce::AudioProcessorValueTreeState& apvts, const Chain_Settings& settings)
+{
+    visit_chain_settings(settings, [&apvts](juce::StringRef id, float value) {
+        auto* parameter = apvts.getParameter(id);
+        parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+    });
+}
+
+bool same_filters(const Chain_Settings& a, const Chain_Settings& b)
+{
+    return a.low_pass_freq == b.low_pass_freq && a.high_pass_freq == b.high_pass_freq
+        && a.low_pass_slope == b.low_pass_slope && a.high_pass_slope == b.high_pass_slope;
+}
+
+Split_Params get_split_params(const Chain_Settings& settings)
+{
+    Split_Params params;
+    params.low_pass_freq = settings.low_pass_freq;
+    params.high_pass_freq = settings.high_pass_freq;
+    params.low_pass_slope = settings.low_pass_slope;
+    params.high_pass_slope = settings.high_pass_slope;
+    params.delay_ms = settings.delay_ms;
+    params.delay_storage = settings.delay_storage;
+    return params;
+}
+
 juce::AudioProcessorValueTreeState::ParameterLayout FreqencyDependentDelayerAudioProcessor::create_parameter_layout()
 {
     juce::AudioProcessorValueTreeState::ParameterLayout layout;
@@ -335,71 +645,356 @@ juce::AudioProcessorValueTreeState::ParameterLayout FreqencyDependentDelayerAudi
         std::make_unique<juce::AudioParameterFloat>(
             "Delay",
             "Delay",
-            juce::NormalisableRange<float>(-200.f, 200.f, 2.f, 1.f), 
+            juce::NormalisableRange<float>(-max_delay_ms, max_delay_ms, 2.f, 1.f), 
             0.f
         )
     );
     juce::StringArray string_array;
-    for (int order = 2; order <= 8; order += 2) {
+    for (int order = 2; order <= 2 * max_pass_sections; order += 2) {
         juce::String str;
         str << order * 6;
         str << " dB/Oct";
         string_array.add(str); 
     }
-    layout.add(std::make_unique<juce::AudioParameterChoice>("Low Pass Slope", "Low Pass Slope", string_array, 0));
-    layout.add(std::make_unique<juce::AudioParameterChoice>("High Pass Slope", "High Pass Slope", string_array, 0));
+    // the compact state stores slope indices, only the legacy ValueTree state needs renamed_parameters
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Low Pass Slope V2", "Low Pass Slope", string_array, 0));
+    layout.add(std::make_unique<juce::AudioParameterChoice>("High Pass Slope V2", "High Pass Slope", string_array, 0));
+    // switching reallocates the delay lines, which automation can't do on the audio thread
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Delay Storage", "Delay Storage", juce::StringArray{ "32-bit Float", "24-bit Packed" }, 0,
+        juce::AudioParameterChoiceAttributes().withAutomatable(false)));
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Mode", "Mode", juce::StringArray{ "Split", "Allpass", "Spectral", "Multirate" }, 0));
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Hop Size", "Hop Size", juce::StringArray{ "64", "128", "256", "512" }, 2));
+    layout.add(std::make_unique<juce::AudioParameterFloat>("Morph", "Morph", juce::NormalisableRange<float>(0.f, 1.f, 0.f, 1.f), 0.f));
+    layout.add(std::make_unique<juce::AudioParameterBool>("Morph Enabled", "Morph Enabled", false));
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Delay Estimation", "Delay Estimation", juce::StringArray{ "Off", "Suggest", "Apply" }, 0));
     return layout;
 }
 
-void FreqencyDependentDelayerAudioProcessor::update_shift_buffer(int num_samples_new, std::vector<float>& shift_buffer)
+void FreqencyDependentDelayerAudioProcessor::update_estimator_thread()
 {
-    int num_samples = shift_buffer.size();
-    
-    int diff = num_samples_new - num_samples;
-    if (diff < 0)
-    {
-        shift_buffer.erase(shift_buffer.begin(), shift_buffer.begin() + std::abs(diff));
-    }
-    else if(diff > 0)
-    { 
-        std::vector<float> new_vec(diff, 0); // fill with 0 means 2 clicks
-        // Implement fade in/out
-        shift_buffer.insert(shift_buffer.begin(), new_vec.begin(), new_vec.end());
-     }
+    // the analysis thread only runs while there is a sidechain to compare with
+    auto* sidechain = getBus(true, 1);
+    auto estimating = static_cast<Estimation_Mode>(read_parameter(apvts, "Delay Estimation")) != Estimation_Mode::Estimation_Off;
+    delay_estimator.set_running(estimating && sidechain != nullptr && sidechain->isEnabled());
+}
+
+int FreqencyDependentDelayerAudioProcessor::get_num_background_threads() const
+{
+    return (allpass_fitter.is_running() ? 1 : 0) + (morph_builder.is_running() ? 1 : 0)
+        + (delay_estimator.is_running() ? 1 : 0) + channel_workers.get_num_workers();
+}
+
+void FreqencyDependentDelayerAudioProcessor::set_delay_storage(Delay_Storage storage)
+{
+    // the wrappers output silence while the delay lines are reallocated
+    suspendProcessing(true);
+    split_engine.set_storage(storage);
+    for (auto& band : multirate_bands)
+        band.set_storage(storage);
+    suspendProcessing(false);
 }
 
 void FreqencyDependentDelayerAudioProcessor::update_processing()
 {
     auto chain_settings = get_chain_settings(apvts);
 
-    auto low_pass_coefficients = juce::dsp::FilterDesign<float>::designIIRLowpassHighOrderButterworthMethod(chain_settings.low_pass_freq, getSampleRate(), 2 * (chain_settings.low_pass_slope + 1));
-    update_pass_filter(pass_chain_mono.get<Pass_Chain_Positions::Low_Pass>(), low_pass_coefficients, chain_settings.low_pass_slope);
+    auto params = get_split_params(chain_settings);
+    auto multirate = chain_settings.mode == Delay_Mode::Mode_Multirate;
+    auto design_rate = getSampleRate();
+    if (multirate)
+    {
+        auto stages = Multirate_Band::choose_stages(getSampleRate(), chain_settings.low_pass_freq);
+        for (auto& band : multirate_bands)
+        {
+            if (!multirate_active)
+                band.reset(); // drop what was left from the last time the mode was on
+            band.set_stages(stages);
+        }
+        design_rate = getSampleRate() / (1 << stages);
+    }
+    multirate_active = multirate;
+
+    // only the split mode crossfades, anywhere else the fade simply completes
+    auto split = chain_settings.mode == Delay_Mode::Mode_Split;
+    if (!split)
+    {
+        split_engine.finish_crossfade();
+    }
 
-    auto high_pass_coefficients = juce::dsp::FilterDesign<float>::designIIRHighpassHighOrderButterworthMethod(chain_settings.high_pass_freq, getSampleRate(), 2 * (chain_settings.high_pass_slope + 1));
-    update_pass_filter(pass_chain_mono.get<Pass_Chain_Positions::High_Pass>(), high_pass_coefficients, chain_settings.high_pass_slope);
+    // the morph table is designed at the host rate, and waits for a running crossfade like any filter change
+    auto morphing = chain_settings.morph_enabled && morph_table.valid && !multirate && !split_engine.is_crossfading();
+    if (morphing)
+    {
+        apply_morph(chain_settings.morph);
+        params.delay_ms = morph_table.delay_a_ms + chain_settings.morph * (morph_table.delay_b_ms - morph_table.delay_a_ms);
+    }
+    else
+    {
+        split_engine.set_filters(params, design_rate, split);
+    }
 
-    int num_samples_new = std::round(getSampleRate() * std::abs(chain_settings.delay_ms) / 1000);
-    for (int ch = 0; ch < shift_buffers.size(); ch++)
+    // an applied estimate and a morphed delay move while playing, so the delay lines fade over to them
+    float estimated_delay_ms;
+    auto estimated = chain_settings.delay_estimation == Estimation_Mode::Estimation_Apply
+        && delay_estimator.get_applied_delay_ms(estimated_delay_ms);
+    if (estimated)
+    {
+        params.delay_ms = estimated_delay_ms; // already smoothed by the estimator
+    }
+    auto fade = estimated || morphing;
+    auto fade_samples = fade ? split_engine.get_delay_fade_samples() : 0;
+
+    split_engine.set_delay(params.delay_ms, fade);
+    int signed_samples = std::round(getSampleRate() * params.delay_ms / 1000);
+    for (int ch = 0; ch < split_engine.get_num_channels(); ch++)
     { 
-        update_shift_buffer(num_samples_new, shift_buffers[ch]);
+        auto& delay_line = split_engine.get_delay_line(ch);
+        if (chain_settings.mode == Delay_Mode::Mode_Allpass)
+        {
+            delay_line.set_delay((int)std::round(getSampleRate() * allpass_base_delay_ms / 1000));
+        }
+        else if (multirate)
+        {
+            multirate_bands[ch].set_delay(signed_samples, fade_samples);
+            delay_line.set_delay(multirate_bands[ch].get_rest_delay(), fade_samples);
+        }
+    }
+}
+
+void FreqencyDependentDelayerAudioProcessor::apply_morph(float morph)
+{
+    auto position = juce::jlimit(0.f, 1.f, morph) * (morph_table_size - 1);
+    auto index = juce::jmin((int)position, morph_table_size - 2);
+    auto fraction = position - index;
+    auto& from = morph_table.entries[index];
+    auto& to = morph_table.entries[index + 1];
+    for (int ch = 0; ch < split_engine.get_num_channels(); ch++)
+    {
+        auto& pass_chain = split_engine.get_pass_chain(ch);
+        morph_pass_filter(pass_chain.get<Pass_Chain_Positions::Low_Pass>(), from.low_pass, to.low_pass, fraction, morph_table.low_pass_sections);
+        morph_pass_filter(pass_chain.get<Pass_Chain_Positions::High_Pass>(), from.high_pass, to.high_pass, fraction, morph_table.high_pass_sections);
+    }
+    split_engine.invalidate_filters();
+}
+
+void FreqencyDependentDelayerAudioProcessor::store_snapshot(int index)
+{
+    snapshots[index] = get_chain_settings(apvts);
+    snapshot_stored[index] = true;
+    if (snapshot_stored[0] && snapshot_stored[1])
+        morph_builder.set_snapshots(snapshots[0], snapshots[1]);
+}
+
+void FreqencyDependentDelayerAudioProcessor::design_presets(double sample_rate)
+{
+    preset_designs.resize(presets.size());
+    for (size_t i = 0; i < presets.size(); i++)
+    {
+        auto& settings = presets[i].settings;
+        auto& design = preset_designs[i];
+        design.settings = settings;
+        design.low_pass = design_low_pass(settings.low_pass_freq, sample_rate, settings.low_pass_slope);
+        design.high_pass = design_high_pass(settings.high_pass_freq, sample_rate, settings.high_pass_slope);
+    }
+}
+
+bool FreqencyDependentDelayerAudioProcessor::apply_preset_design(const Preset_Design& design)
+{
+    // no designer calls here, only copies of the prepared coefficients;
+    // the parameters were set before the preset was queued, read back their snapped values
+    auto params = get_split_params(get_chain_settings(apvts));
+    params.low_pass_slope = design.settings.low_pass_slope;
+    params.high_pass_slope = design.settings.high_pass_slope;
+    return split_engine.set_filters(design.low_pass, design.high_pass, params);
+}
+
+void FreqencyDependentDelayerAudioProcessor::update_allpass_cascades(const Allpass_Design& design)
+{
+    int num_sections_new = juce::jmin((int)design.coefficients.size(), max_allpass_sections);
+    for (auto& cascade : allpass_cascades)
+    {
+        for (int i = 0; i < max_allpass_sections; i++)
+        {
+            // sections past the design have to stay pass-through for the kernel
+            auto* raw = i < num_sections_new ? design.coefficients[i]->getRawCoefficients() : nullptr;
+            cascade.coefficients[0][i] = raw != nullptr ? raw[0] : 1.f;
+            for (int k = 1; k < 5; k++)
+                cascade.coefficients[k][i] = raw != nullptr ? raw[k] : 0.f;
+            if (i >= num_allpass_sections)
+                cascade.state[0][i] = cascade.state[1][i] = 0.f; // section was idle, drop stale state
+        }
+        cascade.num_sections = num_sections_new;
+    }
+    num_allpass_sections = num_sections_new;
+    allpass_base_delay_ms = design.base_delay_ms;
+}
+
+void FreqencyDependentDelayerAudioProcessor::process_allpass_channel(juce::AudioBuffer<float>& buffer, int ch)
+{
+    auto* data = buffer.getWritePointer(ch);
+    FDD_PROFILE_BEGIN(profiler, ch);
+    // every cpu path gives the scalar kernel's samples, the allpass cases of cpu-paths check it
+    split_engine.get_kernels().cascade(data, buffer.getNumSamples(), allpass_cascades[ch]);
+    FDD_PROFILE_LAP(Stage_Allpass);
+    split_engine.get_delay_line(ch).process(data, buffer.getNumSamples());
+    FDD_PROFILE_LAP(Stage_Delay);
+}
+
+void FreqencyDependentDelayerAudioProcessor::process_multirate_channel(juce::AudioBuffer<float>& buffer, int ch)
+{
+    FDD_PROFILE_BEGIN(profiler, ch);
+    multirate_bands[ch].process(buffer.getWritePointer(ch), split_engine.get_scratch(ch), buffer.getNumSamples(),
+        split_engine.get_pass_chain(ch), split_engine.get_delay_line(ch));
+    FDD_PROFILE_LAP(Stage_Multirate);
+}
+
+void FreqencyDependentDelayerAudioProcessor::processorLayoutsChanged()
+{
+    update_estimator_thread();
+}
+
+void FreqencyDependentDelayerAudioProcessor::setNonRealtime (bool isNonRealtime) noexcept
+{
+    AudioProcessor::setNonRealtime(isNonRealtime);
+    // hosts switch back outside of processing, the pool is not kept idle through realtime playback
+    if (isNonRealtime)
+    {
+        start_channel_workers();
+    }
+    else
+    {
+        channel_workers.stop();
     }
 }
 
-void FreqencyDependentDelayerAudioProcessor::delay_signal(float* buffer, int buffer_size, std::vector<float>& shift_buffer)
+#if FDD_CLAP
+clap_process_status FreqencyDependentDelayerAudioProcessor::clap_direct_process(const clap_process* process) noexcept
 {
-    int shift_buffer_size = shift_buffer.size();
-    if (shift_buffer_size > 0)
+    if (process->audio_inputs_count == 0 || process->audio_outputs_count == 0)
+        return CLAP_PROCESS_CONTINUE;
+
+    auto& input = process->audio_inputs[0];
+    auto& output = process->audio_outputs[0];
+    auto num_samples = (int)process->frames_count;
+    if (process->audio_inputs_count > 1 && process->audio_inputs[1].channel_count > 0 && input.channel_count > 0)
+    {
+        push_sidechain(input.data32[0], process->audio_inputs[1].data32[0], num_samples);
+    }
+    auto num_channels = (int)juce::jmin(input.channel_count, output.channel_count, (uint32_t)clap_channels.size());
+    for (int ch = 0; ch < num_channels; ch++)
+    {
+        if (output.data32[ch] != input.data32[ch])
+            juce::FloatVectorOperations::copy(output.data32[ch], input.data32[ch], num_samples);
+    }
+
+    const juce::ScopedLock lock(getCallbackLock());
+    juce::MidiBuffer no_midi;
+    auto* events = process->in_events;
+    auto num_events = events->size(events);
+    int position = 0;
+    for (uint32_t e = 0; e <= num_events; e++)
     {
-        //std::vector<float> data_vec(buffer_left, buffer_left+buffer_size); // params pointers to (begin, end) of array
-        shift_buffer.insert(shift_buffer.end(), buffer, buffer + buffer_size);
-        //shift_block.insert(shift_block.end(), data_vec.begin(), data_vec.end());
-        for (int i = 0; i < buffer_size; i++)
+        // run the block up to the event, which then applies from its own sample on
+        auto* header = e < num_events ? events->get(events, e) : nullptr;
+        auto until = header != nullptr ? juce::jlimit(position, num_samples, (int)header->time) : num_samples;
+        if (until > position && !isSuspended())
         {
-            buffer[i] = shift_buffer[i];
+            for (int ch = 0; ch < num_channels; ch++)
+                clap_channels[ch] = output.data32[ch] + position;
+            juce::AudioBuffer<float> range(clap_channels.data(), num_channels, until - position);
+            processBlock(range, no_midi);
         }
-        shift_buffer.erase(shift_buffer.begin(), shift_buffer.begin() + buffer_size);
+        position = until;
+
+        if (header != nullptr && header->space_id == CLAP_CORE_EVENT_SPACE_ID && header->type == CLAP_EVENT_PARAM_VALUE)
+            apply_clap_parameter(*reinterpret_cast<const clap_event_param_value*>(header));
+    }
+    return CLAP_PROCESS_CONTINUE;
+}
+
+void FreqencyDependentDelayerAudioProcessor::apply_clap_parameter(const clap_event_param_value& event)
+{
+    for (auto& [id, parameter] : clap_parameters)
+    {
+        if (id != event.param_id)
+            continue;
+
+        // CLAP values come in the parameter's own range; the listeners hear about it on the message thread
+        parameter_sync.set(*parameter, (float)event.value);
+        return;
     }
-    DBG("shift_buffer before: " << shift_buffer_size << "shift_buffer after" << shift_buffer.size());
+}
+#endif
+
+void FreqencyDependentDelayerAudioProcessor::push_sidechain(const float* input, const float* sidechain, int num_samples)
+{
+    // nothing but the FIFO push on this thread, the estimator does the rest
+    if (static_cast<Estimation_Mode>(read_parameter(apvts, "Delay Estimation")) == Estimation_Mode::Estimation_Off)
+        return;
+    delay_estimator.push(input, sidechain, num_samples, read_parameter(apvts, "Low Pass Freq"), read_parameter(apvts, "High Pass Freq"));
+}
+
+void FreqencyDependentDelayerAudioProcessor::start_channel_workers()
+{
+    // the calling thread takes a share too, so one thread fewer than there are jobs
+    int n_channels = juce::jmax(getMainBusNumInputChannels(), getMainBusNumOutputChannels());
+    channel_workers.start(juce::jmin(n_channels, juce::SystemStats::getNumCpus()) - 1);
+}
+
+void FreqencyDependentDelayerAudioProcessor::for_each_channel(int num_channels, const std::function<void(int)>& process_channel)
+{
+    // every channel owns its filters, delay line and scratch row, so the order does not matter
+    if (isNonRealtime() && channel_workers.get_num_workers() > 0 && num_channels > 1)
+    {
+        channel_workers.run(num_channels, process_channel);
+        return;
+    }
+
+    for (int ch = 0; ch < num_channels; ch++) // for soome reason people use ++ch?
+    {
+        process_channel(ch);
+    }
+}
+
+std::vector<Curve_Point> FreqencyDependentDelayerAudioProcessor::get_group_delay_curve() const
+{
+    std::vector<Curve_Point> curve;
+    auto curve_tree = apvts.state.getChildWithName("Group_Delay_Curve");
+    for (auto point : curve_tree)
+    {
+        curve.push_back({ (float)point.getProperty("frequency"), (float)point.getProperty("delay_ms") });
+    }
+    return curve;
+}
+
+void FreqencyDependentDelayerAudioProcessor::set_group_delay_curve(const std::vector<Curve_Point>& curve)
+{
+    auto curve_tree = apvts.state.getOrCreateChildWithName("Group_Delay_Curve", nullptr);
+    curve_tree.removeAllChildren(nullptr);
+    for (auto& point : curve)
+    {
+        juce::ValueTree point_tree("Point");
+        point_tree.setProperty("frequency", point.frequency, nullptr);
+        point_tree.setProperty("delay_ms", point.delay_ms, nullptr);
+        curve_tree.appendChild(point_tree, nullptr);
+    }
+    send_group_delay_curve(curve);
+}
+
+void FreqencyDependentDelayerAudioProcessor::send_group_delay_curve(const std::vector<Curve_Point>& curve)
+{
+    group_delay_curve_version++;
+    allpass_fitter.set_curve(curve);
+    spectral_delay.set_curve(curve);
+}
+
+int FreqencyDependentDelayerAudioProcessor::get_mode_latency(const Chain_Settings& chain_settings) const
+{
+    if (chain_settings.mode == Delay_Mode::Mode_Spectral)
+        return Spectral_Delay::hop_size_for(chain_settings.hop_size_index) * 4;
+    if (chain_settings.mode == Delay_Mode::Mode_Multirate)
+        return Multirate_Band::get_latency_samples(getSampleRate());
+    return 0;
 }
 
 void FreqencyDependentDelayerAudioProcessor::update_coefficients(Coefficients& old, const Coefficients& replacements)
@@ -9,29 +9,34 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include <array>
+#include <atomic>
 #include <iostream>
 #include <vector>
-
-enum Slope {
-    Slope_12,
-    Slope_24,
-    Slope_36,
-    Slope_48
-};
-
-struct Chain_Settings {
-    float low_pass_freq{ 20000.f }, high_pass_freq{ 20.f }, delay_ms{ 0.f };
-    Slope low_pass_slope{ Slope::Slope_12 }, high_pass_slope{ Slope::Slope_12 };
+#include "ChainSettings.h"
+#include "ParameterSync.h"
+#include "SplitEngine.h"
+#include "AllpassDesign.h"
+#include "SpectralDelay.h"
+#include "MorphTable.h"
+#include "MultirateBand.h"
+#include "ChannelWorkers.h"
+#include "StageProfiler.h"
+#include "DelayEstimator.h"
+
+#if FDD_CLAP
+ #include <clap-juce-extensions/clap-juce-extensions.h>
+#endif
+
+struct Preset {
+    juce::String name;
+    Chain_Settings settings;
 };
-Chain_Settings get_chain_settings(juce::AudioProcessorValueTreeState& apvts);
-
-using Filter = juce::dsp::IIR::Filter<float>;
-using Pass_Filter = juce::dsp::ProcessorChain< Filter, Filter, Filter, Filter >;
-using Pass_Chain = juce::dsp::ProcessorChain< Pass_Filter, Pass_Filter >;
 
-enum Pass_Chain_Positions {
-    High_Pass,
-    Low_Pass
+// Coefficients of a preset designed ahead of time for the current sample rate.
+struct Preset_Design {
+    Chain_Settings settings;
+    Pass_Design low_pass, high_pass;
 };
 
 
@@ -42,6 +47,9 @@ class FreqencyDependentDelayerAudioProcessor  : public juce::AudioProcessor
                             #if JucePlugin_Enable_ARA
                              , public juce::AudioProcessorARAExtension
                             #endif
+                            #if FDD_CLAP
+                             , public clap_juce_extensions::clap_juce_audio_processor_capabilities
+                            #endif
 {
 public:
     //==============================================================================
@@ -81,50 +89,139 @@ public:
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
 
+    void setNonRealtime (bool isNonRealtime) noexcept override;
+    void processorLayoutsChanged() override;
+
+#if FDD_CLAP
+    // The CLAP wrapper hands over the whole process call, so parameter
+    // events take effect on their own sample instead of at the block start.
+    // The host's clap.thread-pool is not used: clap-juce-extensions gives the
+    // plugin no way to expose it, so channels stay on the calling thread here.
+    bool supportsDirectProcess() override { return true; }
+    clap_process_status clap_direct_process(const clap_process* process) noexcept override;
+#endif
+
     //=== MY PARAMETERS
     static juce::AudioProcessorValueTreeState::ParameterLayout create_parameter_layout();
     juce::AudioProcessorValueTreeState apvts{ *this, nullptr, "Parameters", create_parameter_layout() };
+    // State loads and audio thread parameter events go through here, not the listeners.
+    Parameter_Sync parameter_sync{ *this };
+
+    // Group delay curve for the allpass mode, stored in apvts.state (message thread only).
+    std::vector<Curve_Point> get_group_delay_curve() const;
+    void set_group_delay_curve(const std::vector<Curve_Point>& curve);
+    // Counts curve changes, state loads included, so the editor can tell when to reload.
+    int get_group_delay_curve_version() const { return group_delay_curve_version.load(); }
+    // Offline renders: after prepareToPlay, waits for the allpass fit of the curve.
+    bool wait_for_allpass_design(int timeout_ms) { return allpass_fitter.wait_for_design(timeout_ms); }
+
+    // A/B snapshots for morphing (message thread).
+    void store_snapshot(int index);
+    bool has_snapshot(int index) const { return snapshot_stored[index]; }
+
+    // Sidechain against input, filled from the audio thread; the editor shows its suggestion.
+    Delay_Estimator delay_estimator;
+
+    // Threads this instance has started so far: fitter, morph builder, estimator and workers.
+    int get_num_background_threads() const;
+
+#if FDD_ENABLE_PROFILING
+    // Stage timings; FDD_TRACE_FILE names a Chrome trace written on releaseResources.
+    Stage_Profiler profiler;
+#endif
 
 
 private:
-    Pass_Chain pass_chain_mono;
+    // Split mode as a whole; the other modes borrow its cascades and delay lines.
+    Split_Engine split_engine;
     using Coefficients = Filter::CoefficientsPtr;
     static void update_coefficients(Coefficients& old, const Coefficients& replacements);
-    
-    template<int Index, typename ChainType, typename CoefficientType>
-    void update(ChainType& chain_part, const CoefficientType& pass_coefficients) {
-        update_coefficients(chain_part.template get<Index>().coefficients, pass_coefficients[Index]);
-        chain_part.template setBypassed<Index>(false);
+
+    // Writes interpolated coefficients straight into the stages, no designer involved.
+    template<int Index, typename ChainType>
+    void morph_stage(ChainType& chain_part, const Morph_Sections& from, const Morph_Sections& to, float fraction, int num_sections) {
+        auto& filter = chain_part.template get<Index>();
+        chain_part.template setBypassed<Index>(Index >= num_sections);
+        if (Index >= num_sections || filter.coefficients->getFilterOrder() != 2)
+            return;
+        auto* raw = filter.coefficients->getRawCoefficients();
+        for (int k = 0; k < biquad_values; k++)
+        {
+            auto value = from[Index * biquad_values + k];
+            raw[k] = value + fraction * (to[Index * biquad_values + k] - value);
+        }
     };
 
-    template<typename ChainType, typename CoefficientType>
-    void update_pass_filter(ChainType& chain_part,
-            const CoefficientType& pass_coefficients,
-            Slope& slope) {
-        chain_part.template setBypassed<0>(true);
-        chain_part.template setBypassed<1>(true);
-        chain_part.template setBypassed<2>(true);
-        chain_part.template setBypassed<3>(true);
-
-        switch (slope) {
-        case Slope_48:
-            update<3>(chain_part, pass_coefficients);
-        case Slope_36:
-            update<2>(chain_part, pass_coefficients);
-        case Slope_24:
-            update<1>(chain_part, pass_coefficients);
-        case Slope_12:
-            update<0>(chain_part, pass_coefficients);
-        };
+    template<typename ChainType>
+    void morph_pass_filter(ChainType& chain_part, const Morph_Sections& from, const Morph_Sections& to, float fraction, int num_sections) {
+        for_each_stage([&](auto index) { morph_stage<decltype(index)::value>(chain_part, from, to, fraction, num_sections); });
     };
 
-    //juce::dsp::AudioBlock<float> shift_block, shift_block_copy;
-    juce::AudioBuffer<float> cut_buffer;
-    std::vector < std::vector<float> > shift_buffers;
-    void delay_signal(float* buffer, int buffer_size, std::vector<float>& shift_buffer);
-    void update_shift_buffer(int num_samples_new, std::vector<float>& shift_buffer);
+    // Multirate mode runs the active pass chains at the band rate of these.
+    std::vector<Multirate_Band> multirate_bands;
+    bool multirate_active = false;
+    void process_multirate_channel(juce::AudioBuffer<float>& buffer, int ch);
+
+    std::vector<Preset> presets;
+    std::vector<Preset_Design> preset_designs;
+    std::atomic<int> pending_preset{ -1 };
+    int current_program = 0;
+    void design_presets(double sample_rate);
+    bool apply_preset_design(const Preset_Design& design);
+
+    std::array<Chain_Settings, 2> snapshots;
+    std::array<bool, 2> snapshot_stored{ false, false };
+    Morph_Builder morph_builder;
+    Morph_Table morph_table;
+    void apply_morph(float morph);
+
+    static constexpr juce::uint32 compact_state_magic = 0x53444446; // "FDDS"
+    static constexpr int compact_state_version = 3;
+    void write_compact_state(juce::MemoryBlock& dest_data);
+    bool read_compact_state(const void* data, int size_in_bytes);
+
+    // The fitted sections run through the cascade kernel, one cascade per channel.
+    static_assert(max_allpass_sections <= max_cascade_sections, "the fitted sections have to fit one cascade");
+    Allpass_Fitter allpass_fitter;
+    std::vector<Biquad_Cascade> allpass_cascades;
+    int num_allpass_sections = 0;
+    float allpass_base_delay_ms = 0.f;
+    void update_allpass_cascades(const Allpass_Design& design);
+    void process_allpass_channel(juce::AudioBuffer<float>& buffer, int ch);
+
+    // Offline renders spread channels over these; output matches the serial path.
+    // Started when the host goes non-realtime, stopped when it comes back.
+    Channel_Workers channel_workers;
+    void start_channel_workers();
+    void for_each_channel(int num_channels, const std::function<void(int)>& process_channel);
+
+#if FDD_CLAP
+    std::vector<std::pair<clap_id, juce::RangedAudioParameter*>> clap_parameters;
+    std::vector<float*> clap_channels;
+    void apply_clap_parameter(const clap_event_param_value& event);
+#endif
+
+    Spectral_Delay spectral_delay;
+    std::atomic<int> group_delay_curve_version{ 0 };
+    void send_group_delay_curve(const std::vector<Curve_Point>& curve);
+    int get_mode_latency(const Chain_Settings& chain_settings) const;
+    void push_sidechain(const float* input, const float* sidechain, int num_samples);
     
     void update_processing();
+    double prepared_sample_rate = 0.;
+
+    // Storage changes reallocate, so they arrive here on the message thread.
+    juce::ParameterAttachment storage_attachment{ *apvts.getParameter("Delay Storage"),
+        [this](float value) { set_delay_storage(static_cast<Delay_Storage>((int)value)); } };
+    void set_delay_storage(Delay_Storage storage);
+    juce::ParameterAttachment estimation_attachment{ *apvts.getParameter("Delay Estimation"),
+        [this](float) { update_estimator_thread(); } };
+    void update_estimator_thread();
+    // The allpass fitter starts when its mode is first chosen, if no curve started it before.
+    juce::ParameterAttachment mode_attachment{ *apvts.getParameter("Mode"), [this](float value) {
+        if (static_cast<Delay_Mode>((int)value) == Delay_Mode::Mode_Allpass)
+            allpass_fitter.start();
+    } };
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FreqencyDependentDelayerAudioProcessor)
 };
\ No newline at end of file
@@ -0,0 +1,147 @@
+/*
+  ==============================================================================
+
+    pybind11 module around Split_Engine for batch processing from Python.
+    float32 arrays are processed in place without a copy, float64 ones go
+    through a float32 staging block. The GIL is released while processing,
+    so separate engines run in parallel from Python threads.
+
+  ==============================================================================
+*/
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include "SplitEngine.h"
+
+namespace py = pybind11;
+
+namespace
+{
+    class Python_Engine {
+    public:
+        Python_Engine(double sample_rate, int num_channels, int block_size)
+            : max_block_size(juce::jmax(1, block_size))
+        {
+            if (num_channels > max_python_channels)
+                throw py::value_error("too many channels");
+            engine.prepare(sample_rate, juce::jmax(1, num_channels), max_block_size);
+            staging.assign((size_t)(engine.get_num_channels() * max_block_size), 0.f);
+            engine.set_params(params);
+        }
+
+        // A copy: change its fields and assign it back to take effect.
+        Split_Params get_params() const { return params; }
+        void set_params(const Split_Params& new_params)
+        {
+            params = new_params;
+            engine.set_params(params);
+        }
+
+        void reset() { engine.reset(); }
+
+        // Channels first: (channels, samples), or (samples,) for one channel.
+        void process(py::array buffer)
+        {
+            if (buffer.ndim() < 1 || buffer.ndim() > 2)
+                throw py::value_error("expected a (channels, samples) or (samples,) array");
+            if (!buffer.writeable())
+                throw py::value_error("the array is processed in place and has to be writeable");
+
+            auto num_channels = buffer.ndim() == 2 ? (int)buffer.shape(0) : 1;
+            auto num_samples = (int)buffer.shape(buffer.ndim() - 1);
+            if (num_channels > engine.get_num_channels())
+                throw py::value_error("the array has more channels than the engine was made for");
+
+            auto channel_stride = buffer.ndim() == 2 ? buffer.strides(0) : 0;
+            auto sample_stride = buffer.strides(buffer.ndim() - 1);
+            auto* bytes = static_cast<char*>(buffer.mutable_data());
+
+            if (py::isinstance<py::array_t<float>>(buffer) && sample_stride == (py::ssize_t)sizeof(float))
+            {
+                py::gil_scoped_release release;
+                std::array<float*, max_python_channels> channels;
+                for (int start = 0; start < num_samples; start += max_block_size)
+                {
+                    for (int ch = 0; ch < num_channels; ch++)
+                        channels[ch] = reinterpret_cast<float*>(bytes + ch * channel_stride) + start;
+                    engine.process(channels.data(), num_channels, juce::jmin(max_block_size, num_samples - start));
+                }
+                return;
+            }
+            if (py::isinstance<py::array_t<double>>(buffer))
+            {
+                py::gil_scoped_release release;
+                process_double(bytes, channel_stride, sample_stride, num_channels, num_samples);
+                return;
+            }
+            throw py::type_error("expected float32 with contiguous samples, or float64");
+        }
+
+        static constexpr int max_python_channels = 64;
+
+    private:
+        void process_double(char* bytes, py::ssize_t channel_stride, py::ssize_t sample_stride, int num_channels, int num_samples)
+        {
+            std::array<float*, max_python_channels> channels;
+            for (int ch = 0; ch < num_channels; ch++)
+                channels[ch] = staging.data() + ch * max_block_size;
+
+            for (int start = 0; start < num_samples; start += max_block_size)
+            {
+                int n = juce::jmin(max_block_size, num_samples - start);
+                auto sample = [&](int ch, int i) -> double& {
+                    return *reinterpret_cast<double*>(bytes + ch * channel_stride + (start + i) * sample_stride);
+                };
+                for (int ch = 0; ch < num_channels; ch++)
+                    for (int i = 0; i < n; i++)
+                        channels[ch][i] = (float)sample(ch, i);
+                engine.process(channels.data(), num_channels, n);
+                for (int ch = 0; ch < num_channels; ch++)
+                    for (int i = 0; i < n; i++)
+                        sample(ch, i) = channels[ch][i];
+            }
+        }
+
+        Split_Engine engine;
+        Split_Params params;
+        int max_block_size;
+        std::vector<float> staging;
+    };
+}
+
+PYBIND11_MODULE(fdd, m)
+{
+    m.doc() = "Frequency dependent delay: split/delay engine";
+
+    py::enum_<Slope>(m, "Slope")
+        .value("db_12", Slope_12)
+        .value("db_24", Slope_24)
+        .value("db_36", Slope_36)
+        .value("db_48", Slope_48)
+        .value("db_60", Slope_60)
+        .value("db_72", Slope_72)
+        .value("db_84", Slope_84)
+        .value("db_96", Slope_96);
+
+    py::enum_<Delay_Storage>(m, "DelayStorage")
+        .value("float32", Storage_Float)
+        .value("packed_24", Storage_Packed_24);
+
+    py::class_<Split_Params>(m, "Params")
+        .def(py::init<>())
+        .def_readwrite("low_pass_freq", &Split_Params::low_pass_freq)
+        .def_readwrite("high_pass_freq", &Split_Params::high_pass_freq)
+        .def_readwrite("low_pass_slope", &Split_Params::low_pass_slope)
+        .def_readwrite("high_pass_slope", &Split_Params::high_pass_slope)
+        .def_readwrite("delay_ms", &Split_Params::delay_ms)
+        .def_readwrite("delay_storage", &Split_Params::delay_storage);
+
+    py::class_<Python_Engine>(m, "Engine")
+        .def(py::init<double, int, int>(), py::arg("sample_rate"), py::arg("channels") = 2, py::arg("block_size") = 8192)
+        .def_property("params", &Python_Engine::get_params, &Python_Engine::set_params)
+        .def("reset", &Python_Engine::reset)
+        .def("process", &Python_Engine::process, py::arg("buffer"),
+            "Processes a (channels, samples) or (samples,) array in place; float32 is not copied.");
+
+    m.attr("max_channels") = Python_Engine::max_python_channels;
+}
@@ -0,0 +1,415 @@
+/*
+  ==============================================================================
+
+    Renders reference signals through the processor and compares them with
+    stored golden renders, so DSP changes can be checked for output drift.
+
+  ==============================================================================
+*/
+
+#include "ReferenceRender.h"
+
+// CMake passes the git commit; other builds fall back to the time this file was compiled.
+#ifndef FDD_BUILD_ID
+ #define FDD_BUILD_ID JucePlugin_VersionString " " __DATE__ " " __TIME__
+#endif
+
+namespace
+{
+    constexpr juce::uint32 golden_magic = 0x444c4f47; // "GOLD"
+    constexpr double reference_sample_rate = 48000.;
+    constexpr int reference_length = 48000;
+    constexpr int golden_length = 8192; // goldens are checked in, keep them small
+    constexpr int reference_block_size = 512;
+    constexpr int fit_timeout_ms = 30000;
+
+    // Fixed group delay curves for the allpass and spectral cases.
+    const std::vector<Curve_Point> falling_curve{ { 60.f, 6.f }, { 400.f, 2.f }, { 3000.f, 0.5f }, { 16000.f, 0.f } };
+    const std::vector<Curve_Point> notch_curve{ { 100.f, 0.f }, { 800.f, 3.f }, { 1200.f, 3.f }, { 5000.f, 0.f } };
+
+    // Distance in representable floats, NaN compares as infinitely far.
+    int ulp_distance(float a, float b)
+    {
+        if (std::isnan(a) || std::isnan(b))
+            return std::numeric_limits<int>::max();
+
+        auto to_ordered = [](float value) {
+            juce::int32 bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            return bits < 0 ? (juce::int64)std::numeric_limits<juce::int32>::min() - bits : (juce::int64)bits;
+        };
+        auto distance = std::abs(to_ordered(a) - to_ordered(b));
+        return (int)juce::jmin(distance, (juce::int64)std::numeric_limits<int>::max());
+    }
+}
+
+juce::AudioBuffer<float> make_reference_signal(Reference_Signal signal, int num_channels, int num_samples, double sample_rate)
+{
+    juce::AudioBuffer<float> buffer(num_channels, num_samples);
+    buffer.clear();
+    juce::Random random(1234); // fixed seed, the noise has to be identical on every run
+
+    for (int ch = 0; ch < num_channels; ch++)
+    {
+        auto* data = buffer.getWritePointer(ch);
+        switch (signal)
+        {
+        case Signal_Impulse:
+            data[0] = 1.f;
+            break;
+        case Signal_Sweep:
+        {
+            // exponential sweep from 20 Hz to 20 kHz
+            auto duration = num_samples / sample_rate;
+            auto rate = std::log(20000. / 20.);
+            for (int i = 0; i < num_samples; i++)
+            {
+                auto t = i / sample_rate;
+                auto phase = juce::MathConstants<double>::twoPi * 20. * duration / rate * (std::exp(t * rate / duration) - 1);
+                data[i] = (float)(0.5 * std::sin(phase));
+            }
+            break;
+        }
+        case Signal_Noise:
+            for (int i = 0; i < num_samples; i++)
+                data[i] = random.nextFloat() - 0.5f;
+            break;
+        }
+    }
+    return buffer;
+}
+
+std::vector<Reference_Case> make_reference_matrix()
+{
+    std::vector<Reference_Case> matrix;
+    for (auto slope : { Slope_12, Slope_24, Slope_36, Slope_48, Slope_96 })
+    {
+        for (auto frequency : { 80.f, 1000.f, 8000.f })
+        {
+            for (auto delay_ms : { -10.f, 0.f, 4.f, 100.f })
+            {
+                Reference_Case reference_case;
+                reference_case.settings.high_pass_freq = frequency;
+                reference_case.settings.high_pass_slope = slope;
+                reference_case.settings.low_pass_slope = slope;
+                reference_case.settings.delay_ms = delay_ms;
+                matrix.push_back(reference_case);
+            }
+        }
+    }
+
+    for (auto* curve : { &falling_curve, &notch_curve })
+    {
+        Reference_Case reference_case;
+        reference_case.settings.mode = Delay_Mode::Mode_Allpass;
+        reference_case.curve = *curve;
+        matrix.push_back(reference_case);
+
+        // the hop sets the latency and the frame timing, check the smallest and the default
+        for (auto hop_size_index : { 0, 2 })
+        {
+            reference_case.settings.mode = Delay_Mode::Mode_Spectral;
+            reference_case.settings.hop_size_index = hop_size_index;
+            matrix.push_back(reference_case);
+        }
+    }
+
+    // the band rate follows the low pass, 200 Hz decimates by 4 and 1 kHz by 2 at 48 kHz
+    for (auto frequency : { 200.f, 1000.f })
+    {
+        for (auto slope : { Slope_24, Slope_48 })
+        {
+            for (auto delay_ms : { -10.f, 0.f, 4.f })
+            {
+                Reference_Case reference_case;
+                reference_case.settings.mode = Delay_Mode::Mode_Multirate;
+                reference_case.settings.low_pass_freq = frequency;
+                reference_case.settings.low_pass_slope = slope;
+                reference_case.settings.delay_ms = delay_ms;
+                matrix.push_back(reference_case);
+            }
+        }
+    }
+    return matrix;
+}
+
+juce::AudioBuffer<float> render_reference(FreqencyDependentDelayerAudioProcessor& processor, const Reference_Case& reference_case,
+    const juce::AudioBuffer<float>& input, double sample_rate, int block_size)
+{
+    juce::AudioBuffer<float> output(input);
+    juce::MidiBuffer midi;
+
+    set_chain_settings(processor.apvts, reference_case.settings);
+    processor.set_group_delay_curve(reference_case.curve);
+    processor.setRateAndBufferSizeDetails(sample_rate, block_size);
+    processor.prepareToPlay(sample_rate, block_size);
+    // the first block installs the design, which is then the same on every run
+    if (reference_case.settings.mode == Delay_Mode::Mode_Allpass)
+        processor.wait_for_allpass_design(fit_timeout_ms);
+
+    for (int start = 0; start < output.getNumSamples(); start += block_size)
+    {
+        auto num_samples = juce::jmin(block_size, output.getNumSamples() - start);
+        juce::AudioBuffer<float> block(output.getArrayOfWritePointers(), output.getNumChannels(), start, num_samples);
+        processor.processBlock(block, midi);
+    }
+    processor.releaseResources();
+    return output;
+}
+
+Stream_Render_Result render_file(FreqencyDependentDelayerAudioProcessor& processor, const Chain_Settings& settings,
+    const juce::File& input, const juce::File& output, Stream_Render_Options options)
+{
+    juce::MidiBuffer midi;
+    auto fitted = true;
+    auto prepare = [&](int num_channels, double sample_rate, int block_size)
+    {
+        set_chain_settings(processor.apvts, settings);
+        processor.setPlayConfigDetails(num_channels, num_channels, sample_rate, block_size);
+        processor.setNonRealtime(true);
+        processor.prepareToPlay(sample_rate, block_size);
+        // the first block installs the fitted design, the render never runs on an older one
+        if (settings.mode == Delay_Mode::Mode_Allpass)
+            fitted = processor.wait_for_allpass_design(fit_timeout_ms);
+        return processor.getLatencySamples();
+    };
+    auto process = [&](float* const* channels, int num_channels, int num_samples)
+    {
+        juce::AudioBuffer<float> block(channels, num_channels, num_samples);
+        processor.processBlock(block, midi);
+    };
+
+    auto result = render_stream(input, output, prepare, process, options);
+    processor.releaseResources();
+    processor.setNonRealtime(false);
+    if (result.ok && !fitted)
+    {
+        // the output depends on how far the fit got, it must not be kept or cached
+        output.deleteFile();
+        result.ok = false;
+        result.error = "the allpass fit did not finish";
+    }
+    return result;
+}
+
+Stream_Render_Result render_file_cached(FreqencyDependentDelayerAudioProcessor& processor, const Chain_Settings& settings,
+    const juce::File& input, const juce::File& output, Render_Cache& cache, Stream_Render_Options options)
+{
+    // the key takes the full state, curve and snapshots included, not only the settings
+    set_chain_settings(processor.apvts, settings);
+    juce::MemoryBlock state;
+    processor.getStateInformation(state);
+    // the paths are bit exact against each other, the cpu-paths test keeps them so; the kernels
+    // stay part of the build so that a path that ever drifts cannot hand out another one's renders
+    auto build = juce::String(FDD_BUILD_ID) + " " + get_cpu_path_name(select_dsp_kernels().path);
+    auto key = Render_Cache::make_key(input, state, build, options);
+
+    auto start = juce::Time::getMillisecondCounterHiRes();
+    if (cache.fetch(key, output))
+    {
+        Stream_Render_Result result;
+        result.ok = true;
+        result.cached = true;
+        result.seconds = (juce::Time::getMillisecondCounterHiRes() - start) / 1000;
+        return result;
+    }
+
+    auto result = render_file(processor, settings, input, output, options);
+    if (result.ok)
+        cache.store(key, output);
+    return result;
+}
+
+Render_Comparison compare_renders(const juce::AudioBuffer<float>& expected, const juce::AudioBuffer<float>& actual, Render_Tolerance tolerance)
+{
+    Render_Comparison comparison;
+    if (expected.getNumChannels() != actual.getNumChannels() || expected.getNumSamples() != actual.getNumSamples())
+        return comparison;
+
+    for (int ch = 0; ch < expected.getNumChannels(); ch++)
+    {
+        auto* a = expected.getReadPointer(ch);
+        auto* b = actual.getReadPointer(ch);
+        for (int i = 0; i < expected.getNumSamples(); i++)
+        {
+            comparison.max_abs_error = juce::jmax(comparison.max_abs_error, std::abs(a[i] - b[i]));
+            comparison.max_ulps = juce::jmax(comparison.max_ulps, ulp_distance(a[i], b[i]));
+        }
+    }
+    comparison.passed = comparison.max_ulps <= tolerance.max_ulps && comparison.max_abs_error <= tolerance.max_abs_error;
+    return comparison;
+}
+
+bool write_golden(const juce::File& file, const juce::AudioBuffer<float>& buffer)
+{
+    file.deleteFile();
+    juce::FileOutputStream stream(file);
+    if (stream.failedToOpen())
+        return false;
+
+    stream.writeInt((int)golden_magic);
+    stream.writeInt(buffer.getNumChannels());
+    stream.writeInt(buffer.getNumSamples());
+    for (int ch = 0; ch < buffer.getNumChannels(); ch++)
+    {
+        stream.write(buffer.getReadPointer(ch), (size_t)buffer.getNumSamples() * sizeof(float));
+    }
+    return stream.getStatus().wasOk();
+}
+
+bool read_golden(const juce::File& file, juce::AudioBuffer<float>& buffer)
+{
+    juce::FileInputStream stream(file);
+    if (stream.failedToOpen() || (juce::uint32)stream.readInt() != golden_magic)
+        return false;
+
+    auto num_channels = stream.readInt();
+    auto num_samples = stream.readInt();
+    if (num_channels <= 0 || num_samples <= 0
+        || stream.getNumBytesRemaining() != (juce::int64)num_channels * num_samples * (juce::int64)sizeof(float))
+        return false;
+
+    buffer.setSize(num_channels, num_samples);
+    for (int ch = 0; ch < num_channels; ch++)
+    {
+        stream.read(buffer.getWritePointer(ch), num_samples * (int)sizeof(float));
+    }
+    return true;
+}
+
+juce::StringArray run_golden_renders(const juce::File& golden_directory, Render_Tolerance tolerance, bool record)
+{
+    juce::StringArray failures;
+    golden_directory.createDirectory();
+    set_cpu_path_override(Path_Scalar); // bit exact only holds for one set of kernels
+
+    auto matrix = make_reference_matrix();
+    for (size_t i = 0; i < matrix.size(); i++)
+    {
+        for (auto signal : { Signal_Impulse, Signal_Sweep, Signal_Noise })
+        {
+            FreqencyDependentDelayerAudioProcessor processor;
+            auto input = make_reference_signal(signal, 2, golden_length, reference_sample_rate);
+            auto output = render_reference(processor, matrix[i], input, reference_sample_rate, reference_block_size);
+
+            auto name = "case_" + juce::String((int)i) + "_signal_" + juce::String((int)signal) + ".golden";
+            auto file = golden_directory.getChildFile(name);
+            juce::AudioBuffer<float> golden;
+            if (!read_golden(file, golden))
+            {
+                if (record && write_golden(file, output))
+                    continue;
+                failures.add(name + ": no golden render");
+                continue;
+            }
+
+            auto comparison = compare_renders(golden, output, tolerance);
+            if (!comparison.passed)
+            {
+                failures.add(name + ": max error " + juce::String(comparison.max_abs_error)
+                    + ", " + juce::String(comparison.max_ulps) + " ulps");
+            }
+        }
+    }
+    set_cpu_path_override(Path_Auto);
+    return failures;
+}
+
+bool nulls_at_zero_delay(const Reference_Case& reference_case)
+{
+    auto mode = reference_case.settings.mode;
+    return reference_case.settings.delay_ms == 0.f && (mode == Delay_Mode::Mode_Split || mode == Delay_Mode::Mode_Multirate);
+}
+
+Render_Comparison run_null_render(const Reference_Case& reference_case, Render_Tolerance tolerance)
+{
+    auto null_case = reference_case;
+    null_case.settings.delay_ms = 0.f;
+
+    FreqencyDependentDelayerAudioProcessor processor;
+    auto input = make_reference_signal(Signal_Noise, 2, reference_length, reference_sample_rate);
+    auto output = render_reference(processor, null_case, input, reference_sample_rate, reference_block_size);
+
+    // the multirate band comes back late by the resampler latency, the input is held back to match
+    auto latency = processor.getLatencySamples();
+    auto length = input.getNumSamples() - latency;
+    juce::AudioBuffer<float> expected(input.getArrayOfWritePointers(), input.getNumChannels(), 0, length);
+    juce::AudioBuffer<float> actual(output.getArrayOfWritePointers(), output.getNumChannels(), latency, length);
+    return compare_renders(expected, actual, tolerance);
+}
+
+juce::StringArray run_cpu_path_renders(const Reference_Case& reference_case, Render_Tolerance tolerance)
+{
+    juce::StringArray failures;
+    auto input = make_reference_signal(Signal_Noise, 2, reference_length, reference_sample_rate);
+    auto render_with = [&](Cpu_Path path) {
+        set_cpu_path_override(path);
+        FreqencyDependentDelayerAudioProcessor processor;
+        return render_reference(processor, reference_case, input, reference_sample_rate, reference_block_size);
+    };
+
+    auto expected = render_with(Path_Scalar);
+    for (auto path : { Path_SSE2, Path_AVX2, Path_AVX512, Path_NEON })
+    {
+        if (!is_cpu_path_supported(path))
+            continue;
+
+        auto comparison = compare_renders(expected, render_with(path), tolerance);
+        if (!comparison.passed)
+        {
+            failures.add(juce::String(get_cpu_path_name(path)) + ": max error " + juce::String(comparison.max_abs_error)
+                + ", " + juce::String(comparison.max_ulps) + " ulps");
+        }
+    }
+    set_cpu_path_override(Path_Auto);
+    return failures;
+}
+
+Startup_Timing run_startup_benchmark(int num_instances, double sample_rate, int block_size)
+{
+    Startup_Timing timing;
+    timing.num_instances = juce::jmax(1, num_instances);
+    auto mean_ms = [&](juce::int64 start_ticks) {
+        auto seconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start_ticks);
+        return 1000. * seconds / timing.num_instances;
+    };
+
+    std::vector<std::unique_ptr<FreqencyDependentDelayerAudioProcessor>> processors;
+    processors.reserve((size_t)timing.num_instances);
+    auto start = juce::Time::getHighResolutionTicks();
+    for (int i = 0; i < timing.num_instances; i++)
+        processors.push_back(std::make_unique<FreqencyDependentDelayerAudioProcessor>());
+    timing.construct_ms = mean_ms(start);
+
+    auto prepare_all = [&](double rate) {
+        auto prepare_start = juce::Time::getHighResolutionTicks();
+        for (auto& processor : processors)
+        {
+            processor->setRateAndBufferSizeDetails(rate, block_size);
+            processor->prepareToPlay(rate, block_size);
+        }
+        return mean_ms(prepare_start);
+    };
+    timing.prepare_ms = prepare_all(sample_rate);
+
+    // the filters are designed by the first block
+    juce::AudioBuffer<float> block(2, block_size);
+    juce::MidiBuffer midi;
+    start = juce::Time::getHighResolutionTicks();
+    for (auto& processor : processors)
+    {
+        block.clear();
+        processor->processBlock(block, midi);
+    }
+    timing.first_block_ms = mean_ms(start);
+
+    timing.prepare_again_ms = prepare_all(sample_rate);
+    timing.rate_change_ms = prepare_all(2 * sample_rate);
+    for (auto& processor : processors)
+        timing.num_threads += processor->get_num_background_threads();
+
+    start = juce::Time::getHighResolutionTicks();
+    processors.clear();
+    timing.destroy_ms = mean_ms(start);
+    return timing;
+}
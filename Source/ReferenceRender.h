@@ -0,0 +1,91 @@
+/*
+  ==============================================================================
+
+    Renders reference signals through the processor and compares them with
+    stored golden renders, so DSP changes can be checked for output drift.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+#include "PluginProcessor.h"
+#include "StreamingRender.h"
+#include "RenderCache.h"
+
+enum Reference_Signal {
+    Signal_Impulse,
+    Signal_Sweep,
+    Signal_Noise
+};
+
+// Both bounds have to hold; 0 and 0 means bit exact.
+struct Render_Tolerance {
+    float max_abs_error{ 0.f };
+    int max_ulps{ 0 };
+};
+
+struct Render_Comparison {
+    float max_abs_error{ 0.f };
+    int max_ulps{ 0 };
+    bool passed{ false };
+};
+
+juce::AudioBuffer<float> make_reference_signal(Reference_Signal signal, int num_channels, int num_samples, double sample_rate);
+
+struct Reference_Case {
+    Chain_Settings settings;
+    std::vector<Curve_Point> curve; // group delay curve, for the allpass and spectral modes
+};
+
+// Split mode slopes x crossover frequencies x delays, then the allpass and
+// spectral modes on fixed curves and the multirate mode on fixed crossovers.
+std::vector<Reference_Case> make_reference_matrix();
+
+// Renders from a freshly constructed processor; waits for the allpass fit, so
+// the output does not depend on thread timing. The latency is left in.
+juce::AudioBuffer<float> render_reference(FreqencyDependentDelayerAudioProcessor& processor, const Reference_Case& reference_case,
+    const juce::AudioBuffer<float>& input, double sample_rate, int block_size);
+
+// Streams a WAV/RF64 file through the processor, offline, with every input channel.
+// The output is latency compensated and as long as the input. The group delay curve
+// is the processor's own; the allpass mode renders once the fit of it has finished.
+Stream_Render_Result render_file(FreqencyDependentDelayerAudioProcessor& processor, const Chain_Settings& settings,
+    const juce::File& input, const juce::File& output, Stream_Render_Options options = {});
+
+// As render_file(), but takes the output from `cache` when this input, state and build were rendered before.
+Stream_Render_Result render_file_cached(FreqencyDependentDelayerAudioProcessor& processor, const Chain_Settings& settings,
+    const juce::File& input, const juce::File& output, Render_Cache& cache, Stream_Render_Options options = {});
+
+Render_Comparison compare_renders(const juce::AudioBuffer<float>& expected, const juce::AudioBuffer<float>& actual, Render_Tolerance tolerance);
+
+bool write_golden(const juce::File& file, const juce::AudioBuffer<float>& buffer);
+bool read_golden(const juce::File& file, juce::AudioBuffer<float>& buffer);
+
+// Renders every matrix entry and signal with the scalar kernels; records missing
+// goldens when `record` is set. Returns a description of every mismatch.
+juce::StringArray run_golden_renders(const juce::File& golden_directory, Render_Tolerance tolerance, bool record);
+
+// With Delay at 0 the split and multirate modes have to sum back to the input,
+// delayed by the reported latency.
+bool nulls_at_zero_delay(const Reference_Case& reference_case);
+Render_Comparison run_null_render(const Reference_Case& reference_case, Render_Tolerance tolerance);
+
+// Renders with every CPU path the machine supports and compares each against
+// the scalar kernels. Returns a description of every mismatch.
+juce::StringArray run_cpu_path_renders(const Reference_Case& reference_case, Render_Tolerance tolerance);
+
+// Mean milliseconds per instance for each step of a session load.
+struct Startup_Timing {
+    int num_instances{ 0 };
+    double construct_ms{ 0 }, prepare_ms{ 0 }, first_block_ms{ 0 };
+    double prepare_again_ms{ 0 }, rate_change_ms{ 0 }, destroy_ms{ 0 };
+    int num_threads{ 0 }; // background threads of all instances after the rate change
+};
+
+// Constructs and prepares `num_instances` processors the way a host loading a
+// session does, runs one block through each, then prepares them again with the
+// same settings and once more at twice the rate.
+Startup_Timing run_startup_benchmark(int num_instances = 200, double sample_rate = 48000., int block_size = 512);
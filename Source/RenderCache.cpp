@@ -0,0 +1,107 @@
+/*
+  ==============================================================================
+
+    On-disk cache of offline renders, keyed by the content of the input file,
+    the processor state and the build. Repeated batch jobs copy the stored
+    output instead of rendering again; the least recently used entries are
+    evicted once the cache grows past its size limit.
+
+  ==============================================================================
+*/
+
+#include "RenderCache.h"
+
+Render_Cache::Render_Cache(const juce::File& cache_directory, juce::int64 max_size_bytes)
+    : directory(cache_directory), max_bytes(max_size_bytes)
+{
+}
+
+juce::String Render_Cache::make_key(const juce::File& input, const juce::MemoryBlock& state,
+    const juce::String& build_version, const Stream_Render_Options& options)
+{
+    juce::FileInputStream file_stream(input);
+    if (file_stream.failedToOpen())
+        return {};
+
+    // the SHA-256 reader pulls 64 bytes at a time, buffer the file underneath it
+    juce::BufferedInputStream buffered(file_stream, 1 << 20);
+    auto input_hash = juce::SHA256(buffered).getRawData();
+
+    juce::MemoryOutputStream key_data;
+    key_data.write(input_hash.getData(), input_hash.getSize());
+    key_data.writeInt64((juce::int64)state.getSize());
+    key_data.write(state.getData(), state.getSize());
+    key_data.writeString(build_version);
+    key_data.writeInt(options.block_size);
+    key_data.writeInt(options.bits_per_sample);
+    return juce::SHA256(key_data.getData(), key_data.getDataSize()).toHexString();
+}
+
+bool Render_Cache::fetch(const juce::String& key, const juce::File& output)
+{
+    auto entry = get_entry(key);
+    if (key.isEmpty() || !entry.existsAsFile())
+        return false;
+
+    output.deleteFile();
+    if (!entry.copyFileTo(output))
+        return false;
+    entry.setLastModificationTime(juce::Time::getCurrentTime()); // the eviction order
+    return true;
+}
+
+bool Render_Cache::store(const juce::String& key, const juce::File& rendered)
+{
+    if (key.isEmpty() || !directory.createDirectory())
+        return false;
+
+    // written next to the entry and moved in, other jobs never see half a file
+    auto entry = get_entry(key);
+    juce::TemporaryFile temporary(entry);
+    if (!rendered.copyFileTo(temporary.getFile()) || !temporary.overwriteTargetFileWithTemporary())
+        return false;
+
+    if (evict(entry) <= max_bytes)
+        return true;
+
+    // the entry alone does not fit, keeping it would leave the cache over its limit
+    entry.deleteFile();
+    return false;
+}
+
+juce::int64 Render_Cache::get_size() const
+{
+    juce::int64 size = 0;
+    for (auto& entry : get_entries())
+        size += entry.getSize();
+    return size;
+}
+
+juce::Array<juce::File> Render_Cache::get_entries() const
+{
+    // another job's store() in progress shows up as <key>_temp<hex>.wav, keys are plain hex
+    auto entries = directory.findChildFiles(juce::File::findFiles, false, "*.wav");
+    entries.removeIf([](const juce::File& entry) { return entry.getFileName().contains("_temp"); });
+    return entries;
+}
+
+juce::int64 Render_Cache::evict(const juce::File& keep)
+{
+    auto entries = get_entries();
+    std::sort(entries.begin(), entries.end(), [](const juce::File& a, const juce::File& b) {
+        return a.getLastModificationTime() < b.getLastModificationTime();
+    });
+
+    auto size = get_size();
+    for (auto& entry : entries)
+    {
+        if (size <= max_bytes)
+            break;
+        if (entry == keep)
+            continue;
+        auto entry_size = entry.getSize();
+        if (entry.deleteFile())
+            size -= entry_size;
+    }
+    return size;
+}
@@ -0,0 +1,41 @@
+/*
+  ==============================================================================
+
+    On-disk cache of offline renders, keyed by the content of the input file,
+    the processor state and the build. Repeated batch jobs copy the stored
+    output instead of rendering again; the least recently used entries are
+    evicted once the cache grows past its size limit.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "StreamingRender.h"
+
+class Render_Cache {
+public:
+    Render_Cache(const juce::File& directory, juce::int64 max_bytes);
+
+    // Hashes the whole input file, so any edit to it counts as a change.
+    static juce::String make_key(const juce::File& input, const juce::MemoryBlock& state,
+        const juce::String& build_version, const Stream_Render_Options& options);
+
+    // Copies the entry to `output` and marks it as recently used; false on a miss.
+    bool fetch(const juce::String& key, const juce::File& output);
+    // Adds a finished render, then evicts other entries down to the size limit.
+    // False when it was not stored, or when it alone is larger than the limit.
+    bool store(const juce::String& key, const juce::File& rendered);
+
+    juce::int64 get_size() const;
+
+private:
+    juce::File get_entry(const juce::String& key) const { return directory.getChildFile(key + ".wav"); }
+    juce::Array<juce::File> get_entries() const;
+    // Evicts the least recently used entries other than `keep`; returns the size left.
+    juce::int64 evict(const juce::File& keep);
+
+    juce::File directory;
+    juce::int64 max_bytes;
+};
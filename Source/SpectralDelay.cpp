@@ -0,0 +1,229 @@
+/*
+  ==============================================================================
+
+    STFT overlap-add engine that delays every frequency bin on its own,
+    following the same group delay curve as the allpass mode.
+
+  ==============================================================================
+*/
+
+#include "SpectralDelay.h"
+
+namespace
+{
+    constexpr int overlap = 4;
+    // Hann analysis and synthesis windows at 4x overlap sum to 1.5
+    constexpr float overlap_add_gain = 1.f / 1.5f;
+
+    int fft_order_for(int hop_index)
+    {
+        return 8 + hop_index; // fft size = 4 * hop size
+    }
+}
+
+void Spectral_Delay::prepare(double new_sample_rate, int num_channels)
+{
+    sample_rate = new_sample_rate;
+    max_delay_samples = (int)std::ceil(sample_rate * max_spectral_delay_ms / 1000);
+
+    size_t max_spectra = 0;
+    for (int i = 0; i < num_hop_sizes; i++)
+    {
+        auto order = fft_order_for(i);
+        auto size = 1 << order;
+        if (ffts[i] == nullptr)
+        {
+            ffts[i] = std::make_unique<juce::dsp::FFT>(order);
+
+            // periodic Hann, so overlapping windows sum to a constant; like the FFTs it doesn't depend on the rate
+            windows[i].resize((size_t)size);
+            for (int n = 0; n < size; n++)
+                windows[i][n] = 0.5f - 0.5f * std::cos(juce::MathConstants<float>::twoPi * n / size);
+        }
+
+        auto hop = hop_size_for(i);
+        auto capacity = (size_t)(max_delay_samples / hop + 2);
+        max_spectra = juce::jmax(max_spectra, capacity * (size_t)(size / 2 + 1));
+    }
+
+    auto max_fft_size = (size_t)hop_size_for(num_hop_sizes - 1) * overlap;
+    fft_buffer.assign(2 * max_fft_size, 0.f);
+    bin_delay_frames.assign(max_fft_size / 2 + 1, 0);
+    rotation_re.assign(max_fft_size / 2 + 1, 1.f);
+    rotation_im.assign(max_fft_size / 2 + 1, 0.f);
+    spectrum_re.assign(max_fft_size / 2 + 1, 0.f);
+    spectrum_im.assign(max_fft_size / 2 + 1, 0.f);
+
+    channels.resize((size_t)num_channels);
+    for (auto& state : channels)
+    {
+        state.input_fifo.assign(max_fft_size, 0.f);
+        state.output_accumulator.assign(max_fft_size, 0.f);
+        state.spectra.assign(max_spectra, {});
+    }
+
+    auto current = juce::jmax(0, hop_index);
+    hop_index = -1;
+    set_hop_index(current);
+}
+
+void Spectral_Delay::reset()
+{
+    for (auto& state : channels)
+    {
+        std::fill(state.input_fifo.begin(), state.input_fifo.end(), 0.f);
+        std::fill(state.output_accumulator.begin(), state.output_accumulator.end(), 0.f);
+        std::fill(state.spectra.begin(), state.spectra.end(), std::complex<float>{});
+        state.spectra_position = 0;
+    }
+    fifo_position = 0;
+    hop_counter = 0;
+}
+
+void Spectral_Delay::set_hop_index(int new_hop_index)
+{
+    new_hop_index = juce::jlimit(0, num_hop_sizes - 1, new_hop_index);
+    if (new_hop_index == hop_index)
+        return;
+    if (fft_buffer.empty())
+    {
+        hop_index = new_hop_index; // picked up by prepare()
+        return;
+    }
+
+    hop_index = new_hop_index;
+    hop_size = hop_size_for(hop_index);
+    fft_size = hop_size * overlap;
+    num_bins = fft_size / 2 + 1;
+    delay_capacity = max_delay_samples / hop_size + 2;
+    reset();
+    update_bin_delays();
+}
+
+void Spectral_Delay::set_curve(const std::vector<Curve_Point>& curve)
+{
+    juce::SpinLock::ScopedLockType lock(curve_lock);
+    num_pending_points = juce::jmin((int)curve.size(), max_curve_points);
+    std::copy(curve.begin(), curve.begin() + num_pending_points, pending_curve.begin());
+    curve_changed = true;
+}
+
+void Spectral_Delay::update_bin_delays()
+{
+    if (fft_size == 0)
+        return;
+
+    for (int k = 0; k < num_bins; k++)
+    {
+        auto frequency = juce::jmax(1., k * sample_rate / fft_size);
+        auto delay_samples = juce::jlimit(0., (double)max_delay_samples,
+            interpolate_curve(active_curve.data(), num_active_points, frequency) * sample_rate / 1000);
+
+        // whole hops come from the spectra ring, the rest is a phase rotation
+        auto frames = juce::jmin(delay_capacity - 1, juce::roundToInt(delay_samples / hop_size));
+        auto fraction = delay_samples - frames * hop_size;
+        bin_delay_frames[k] = frames;
+        auto angle = -juce::MathConstants<double>::twoPi * k * fraction / fft_size;
+        rotation_re[k] = (float)std::cos(angle);
+        rotation_im[k] = (float)std::sin(angle);
+    }
+}
+
+void Spectral_Delay::process(juce::AudioBuffer<float>& buffer, int num_channels)
+{
+    if (curve_changed.load())
+    {
+        juce::SpinLock::ScopedTryLockType lock(curve_lock);
+        if (lock.isLocked())
+        {
+            num_active_points = num_pending_points;
+            std::copy(pending_curve.begin(), pending_curve.begin() + num_active_points, active_curve.begin());
+            std::sort(active_curve.begin(), active_curve.begin() + num_active_points,
+                [](const Curve_Point& a, const Curve_Point& b) { return a.frequency < b.frequency; });
+            curve_changed = false;
+            update_bin_delays();
+        }
+    }
+
+    num_channels = juce::jmin(num_channels, (int)channels.size());
+    int num_samples = buffer.getNumSamples();
+    for (int start = 0; start < num_samples;)
+    {
+        // never cross a hop boundary, so the fifo segment cannot wrap either
+        int n = juce::jmin(num_samples - start, hop_size - hop_counter);
+        jassert(fifo_position + n <= fft_size);
+        for (int ch = 0; ch < num_channels; ch++)
+        {
+            auto& state = channels[ch];
+            auto* data = buffer.getWritePointer(ch) + start;
+            auto* fifo = state.input_fifo.data() + fifo_position;
+            auto* accumulator = state.output_accumulator.data() + fifo_position;
+            for (int i = 0; i < n; i++)
+            {
+                fifo[i] = data[i];
+                data[i] = accumulator[i];
+                accumulator[i] = 0.f;
+            }
+        }
+
+        fifo_position = (fifo_position + n) % fft_size;
+        hop_counter += n;
+        start += n;
+        if (hop_counter == hop_size)
+        {
+            hop_counter = 0;
+            for (int ch = 0; ch < num_channels; ch++)
+                process_frame(channels[ch]);
+        }
+    }
+}
+
+void Spectral_Delay::process_frame(Channel_State& state)
+{
+    auto* frame = fft_buffer.data();
+    auto* window = windows[hop_index].data();
+
+    // oldest sample sits at fifo_position
+    int first = fft_size - fifo_position;
+    juce::FloatVectorOperations::copy(frame, state.input_fifo.data() + fifo_position, first);
+    juce::FloatVectorOperations::copy(frame + first, state.input_fifo.data(), fifo_position);
+    juce::FloatVectorOperations::multiply(frame, window, fft_size);
+
+    ffts[hop_index]->performRealOnlyForwardTransform(frame, true);
+
+    auto* spectrum = reinterpret_cast<std::complex<float>*>(frame);
+    auto* ring = state.spectra.data();
+    std::copy(spectrum, spectrum + num_bins, ring + (size_t)state.spectra_position * num_bins);
+    for (int k = 0; k < num_bins; k++)
+    {
+        auto slot = state.spectra_position - bin_delay_frames[k];
+        if (slot < 0)
+            slot += delay_capacity;
+        auto delayed = ring[(size_t)slot * num_bins + k];
+        spectrum_re[k] = delayed.real();
+        spectrum_im[k] = delayed.imag();
+    }
+    state.spectra_position = (state.spectra_position + 1) % delay_capacity;
+
+    // unit stride over all four arrays, so the complex multiply vectorises
+    auto* re = spectrum_re.data();
+    auto* im = spectrum_im.data();
+    auto* rotation_real = rotation_re.data();
+    auto* rotation_imag = rotation_im.data();
+    for (int k = 0; k < num_bins; k++)
+    {
+        auto value_re = re[k], value_im = im[k];
+        re[k] = value_re * rotation_real[k] - value_im * rotation_imag[k];
+        im[k] = value_re * rotation_imag[k] + value_im * rotation_real[k];
+    }
+    for (int k = 0; k < num_bins; k++)
+        spectrum[k] = { re[k], im[k] };
+
+    ffts[hop_index]->performRealOnlyInverseTransform(frame);
+    juce::FloatVectorOperations::multiply(frame, window, fft_size);
+    juce::FloatVectorOperations::multiply(frame, overlap_add_gain, fft_size);
+
+    // frame sample k is read back exactly fft_size samples after it was written
+    juce::FloatVectorOperations::add(state.output_accumulator.data() + fifo_position, frame, first);
+    juce::FloatVectorOperations::add(state.output_accumulator.data(), frame + first, fifo_position);
+}
@@ -0,0 +1,70 @@
+/*
+  ==============================================================================
+
+    STFT overlap-add engine that delays every frequency bin on its own,
+    following the same group delay curve as the allpass mode.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <complex>
+#include <memory>
+#include <vector>
+#include "AllpassDesign.h"
+
+constexpr int num_hop_sizes = 4; // 64, 128, 256, 512 samples
+constexpr int max_curve_points = 64;
+constexpr float max_spectral_delay_ms = 250.f;
+
+class Spectral_Delay {
+public:
+    static int hop_size_for(int hop_index) { return 64 << hop_index; }
+
+    // Allocates FFTs, windows and per-bin delay lines for every hop size.
+    void prepare(double sample_rate, int num_channels);
+    void reset();
+
+    // Audio thread; switching hop size clears the engine but never allocates.
+    void set_hop_index(int new_hop_index);
+    int get_latency_samples() const { return fft_size; }
+
+    // Any thread but the audio thread.
+    void set_curve(const std::vector<Curve_Point>& curve);
+
+    void process(juce::AudioBuffer<float>& buffer, int num_channels);
+
+private:
+    struct Channel_State {
+        std::vector<float> input_fifo, output_accumulator;
+        std::vector<std::complex<float>> spectra; // ring of delay_capacity frames
+        int spectra_position = 0;
+    };
+
+    void update_bin_delays();
+    void process_frame(Channel_State& state);
+
+    double sample_rate = 44100.;
+    int max_delay_samples = 0;
+
+    std::array<std::unique_ptr<juce::dsp::FFT>, num_hop_sizes> ffts;
+    std::array<std::vector<float>, num_hop_sizes> windows;
+    std::vector<float> fft_buffer;
+    std::vector<int> bin_delay_frames;
+    // the rotation and the delayed spectrum are kept as separate re/im arrays,
+    // so the complex multiply runs over contiguous floats
+    std::vector<float> rotation_re, rotation_im, spectrum_re, spectrum_im;
+    std::vector<Channel_State> channels;
+
+    int hop_index = -1, hop_size = 0, fft_size = 0, num_bins = 0, delay_capacity = 1;
+    int fifo_position = 0, hop_counter = 0;
+
+    juce::SpinLock curve_lock;
+    std::array<Curve_Point, max_curve_points> pending_curve, active_curve;
+    int num_pending_points = 0, num_active_points = 0;
+    std::atomic<bool> curve_changed{ false };
+};
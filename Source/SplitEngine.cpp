@@ -0,0 +1,366 @@
+/*
+  ==============================================================================
+
+    The split/delay engine without the plugin around it: crossover cascades,
+    the complementary band, the delay lines and the slope crossfade behind a
+    plain prepare/set_params/process interface. Needs juce_dsp only, no
+    plugin client or GUI modules.
+
+  ==============================================================================
+*/
+
+#include "SplitEngine.h"
+
+namespace
+{
+    // Same sections and Q values as FilterDesign's Butterworth method, without its allocations.
+    Pass_Design design_pass(bool low_pass, float frequency, double sample_rate, Slope slope)
+    {
+        Pass_Design design{};
+        auto order = 2 * (slope + 1);
+        for (int i = 0; i <= slope; i++)
+        {
+            auto q = (float)(1.0 / (2.0 * std::cos((2.0 * i + 1.0) * juce::MathConstants<double>::pi / (order * 2.0))));
+            design[i] = low_pass ? juce::dsp::IIR::ArrayCoefficients<float>::makeLowPass(sample_rate, frequency, q)
+                                 : juce::dsp::IIR::ArrayCoefficients<float>::makeHighPass(sample_rate, frequency, q);
+        }
+        return design;
+    }
+
+    void write_pass_filter(Pass_Filter& pass_filter, const Pass_Design& design, Slope slope)
+    {
+        for_each_stage([&](auto index) {
+            // assigning in place keeps the storage, so this never allocates
+            constexpr int Index = decltype(index)::value;
+            pass_filter.setBypassed<Index>(Index > slope);
+            if (Index <= slope)
+                *pass_filter.get<Index>().coefficients = design[Index];
+        });
+    }
+
+    // Bypassed stages still need second order coefficients for the morph.
+    void reset_pass_filter(Pass_Filter& pass_filter)
+    {
+        for_each_stage([&](auto index) {
+            // in place as well, only a fresh stage grows its storage to second order once
+            *pass_filter.get<decltype(index)::value>().coefficients = std::array<float, 6>{ 1.f, 0.f, 0.f, 1.f, 0.f, 0.f };
+        });
+    }
+
+    // Appends the active stages of a filter to the cascade, with their state.
+    void gather_stages(Pass_Filter& pass_filter, int first_slot, const float* s1, const float* s2,
+        Biquad_Cascade& cascade, int* slots)
+    {
+        for_each_stage([&](auto index) {
+            constexpr int Index = decltype(index)::value;
+            if (pass_filter.isBypassed<Index>())
+                return;
+            auto* raw = pass_filter.get<Index>().coefficients->getRawCoefficients();
+            auto section = cascade.num_sections++;
+            for (int k = 0; k < 5; k++)
+                cascade.coefficients[k][section] = raw[k];
+            cascade.state[0][section] = s1[first_slot + Index];
+            cascade.state[1][section] = s2[first_slot + Index];
+            slots[section] = first_slot + Index;
+        });
+    }
+
+    // Samples until every section's slowest pole has decayed by 80 dB, summed over
+    // the cascade since each section settles on the output of the one before.
+    double get_settling_samples(const Biquad_Cascade& cascade)
+    {
+        double total = 0.;
+        for (int section = 0; section < cascade.num_sections; section++)
+        {
+            // poles of z^2 + a1 z + a2
+            double a1 = cascade.coefficients[3][section], a2 = cascade.coefficients[4][section];
+            auto discriminant = a1 * a1 - 4. * a2;
+            auto radius = discriminant < 0. ? std::sqrt(a2) : (std::abs(a1) + std::sqrt(discriminant)) / 2.;
+            if (radius >= 1.)
+                return std::numeric_limits<double>::max();
+            if (radius > 0.)
+                total += std::log(1.0e-4) / std::log(radius);
+        }
+        return total;
+    }
+
+    bool same_filters(const Split_Params& a, const Split_Params& b)
+    {
+        return a.low_pass_freq == b.low_pass_freq && a.high_pass_freq == b.high_pass_freq
+            && a.low_pass_slope == b.low_pass_slope && a.high_pass_slope == b.high_pass_slope;
+    }
+}
+
+Pass_Design design_low_pass(float frequency, double sample_rate, Slope slope)
+{
+    return design_pass(true, frequency, sample_rate, slope);
+}
+
+Pass_Design design_high_pass(float frequency, double sample_rate, Slope slope)
+{
+    return design_pass(false, frequency, sample_rate, slope);
+}
+
+//==============================================================================
+void Split_Engine::prepare(double new_sample_rate, int max_channels, int max_block_size)
+{
+    // hosts prepare again on every transport start and session load
+    auto& new_kernels = select_dsp_kernels();
+    if (new_sample_rate == sample_rate && max_channels == get_num_channels() && max_block_size == block_size
+        && &new_kernels == kernels)
+    {
+        reset();
+        return;
+    }
+
+    sample_rate = new_sample_rate;
+    block_size = max_block_size;
+    kernels = &new_kernels;
+
+    // smaller sizes keep the storage they have
+    cut_buffer.setSize(max_channels, max_block_size, false, false, true);
+    int max_delay_samples = (int)std::ceil(sample_rate * max_delay_ms / 1000);
+    delay_lines.resize(max_channels);
+    for (auto& delay_line : delay_lines)
+    {
+        delay_line.set_storage(storage); // free for lines that were just added
+        delay_line.prepare(max_delay_samples, max_block_size, *kernels);
+    }
+
+    juce::dsp::ProcessSpec spec;
+    spec.maximumBlockSize = max_block_size;
+    spec.numChannels = 1;
+    spec.sampleRate = sample_rate;
+    for (auto& pass_chains : pass_engines)
+    {
+        pass_chains.resize(max_channels);
+        for (auto& pass_chain : pass_chains)
+        {
+            reset_pass_filter(pass_chain.get<Pass_Chain_Positions::Low_Pass>());
+            reset_pass_filter(pass_chain.get<Pass_Chain_Positions::High_Pass>());
+            pass_chain.prepare(spec);
+        }
+    }
+    for (auto& states : stage_states)
+        states.resize(max_channels);
+    cascades.resize(max_channels);
+    standby_buffer.setSize(max_channels, max_block_size, false, false, true);
+    transition_length = juce::jmax(1, (int)std::round(sample_rate * slope_fade_ms / 1000));
+    max_warm_up_length = (int)std::round(sample_rate * max_warm_up_ms / 1000);
+    delay_fade_length = juce::jmax(1, (int)std::round(sample_rate * delay_fade_ms / 1000));
+    reset();
+    filters_up_to_date = false;
+}
+
+void Split_Engine::reset()
+{
+    for (auto& pass_chains : pass_engines)
+    {
+        for (auto& pass_chain : pass_chains)
+            pass_chain.reset();
+    }
+    for (auto& states : stage_states)
+        std::fill(states.begin(), states.end(), Stage_States{});
+    for (auto& delay_line : delay_lines)
+        delay_line.reset();
+    finish_crossfade();
+}
+
+void Split_Engine::set_params(const Split_Params& params)
+{
+    set_filters(params, sample_rate, true);
+    set_storage(params.delay_storage);
+    set_delay(params.delay_ms);
+}
+
+void Split_Engine::process(float* const* channels, int num_channels, int num_samples)
+{
+    juce::ScopedNoDenormals no_denormals;
+    num_channels = juce::jmin(num_channels, get_num_channels());
+    for (int ch = 0; ch < num_channels; ch++)
+    {
+        process_channel(channels[ch], ch, num_samples);
+    }
+    end_block(num_samples);
+}
+
+void Split_Engine::set_filters(const Split_Params& params, double design_rate, bool allow_crossfade)
+{
+    if (is_crossfading())
+        return;
+    if (filters_up_to_date && design_rate == applied_design_rate && same_filters(params, applied_params))
+        return;
+
+    // switching stages in and out of a running cascade clicks, so slope changes
+    // are designed into the standby cascade and faded over to
+    auto crossfade = allow_crossfade && filters_up_to_date && design_rate == applied_design_rate
+        && (params.low_pass_slope != applied_params.low_pass_slope
+            || params.high_pass_slope != applied_params.high_pass_slope);
+
+    // the band rate can sit below a high pass set for the full rate
+    auto max_freq = (float)(0.45 * design_rate);
+    auto low_pass = design_low_pass(juce::jmin(params.low_pass_freq, max_freq), design_rate, params.low_pass_slope);
+    auto high_pass = design_high_pass(juce::jmin(params.high_pass_freq, max_freq), design_rate, params.high_pass_slope);
+    write_filters(crossfade ? standby_chains() : active_chains(), low_pass, high_pass, params);
+    applied_design_rate = design_rate;
+
+    if (crossfade)
+    {
+        start_transition();
+    }
+}
+
+bool Split_Engine::set_filters(const Pass_Design& low_pass, const Pass_Design& high_pass, const Split_Params& params)
+{
+    if (is_crossfading())
+        return false;
+
+    // a preset can change every stage at once, which clicks in a running cascade
+    auto crossfade = filters_up_to_date;
+    write_filters(crossfade ? standby_chains() : active_chains(), low_pass, high_pass, params);
+    applied_design_rate = sample_rate;
+    if (crossfade)
+    {
+        start_transition();
+    }
+    return true;
+}
+
+void Split_Engine::write_filters(std::vector<Pass_Chain>& pass_chains, const Pass_Design& low_pass, const Pass_Design& high_pass, const Split_Params& params)
+{
+    for (auto& pass_chain : pass_chains)
+    {
+        write_pass_filter(pass_chain.get<Pass_Chain_Positions::Low_Pass>(), low_pass, params.low_pass_slope);
+        write_pass_filter(pass_chain.get<Pass_Chain_Positions::High_Pass>(), high_pass, params.high_pass_slope);
+    }
+    applied_params = params;
+    filters_up_to_date = true;
+}
+
+void Split_Engine::set_delay(float signed_delay_ms, bool fade)
+{
+    delay_ms = signed_delay_ms;
+    int num_samples = std::round(sample_rate * std::abs(delay_ms) / 1000);
+    for (auto& delay_line : delay_lines)
+    {
+        delay_line.set_delay(num_samples, fade ? delay_fade_length : 0);
+    }
+}
+
+void Split_Engine::set_storage(Delay_Storage new_storage)
+{
+    storage = new_storage;
+    for (auto& delay_line : delay_lines)
+    {
+        delay_line.set_storage(storage);
+    }
+}
+
+void Split_Engine::finish_crossfade()
+{
+    if (transition_remaining == 0)
+        return;
+
+    transition_remaining = 0;
+    active_engine = 1 - active_engine;
+}
+
+void Split_Engine::process_channel(float* data, int ch, int num_samples)
+{
+    jassert(num_samples <= cut_buffer.getNumSamples());
+    FDD_PROFILE_BEGIN(profiler, ch);
+
+    auto* cut = cut_buffer.getWritePointer(ch);
+    juce::FloatVectorOperations::copy(cut, data, num_samples);
+    if (transition_remaining > 0)
+    {
+        standby_buffer.copyFrom(ch, 0, data, num_samples);
+    }
+
+    run_cascade(active_chains()[ch], active_states()[ch], ch, data, num_samples);
+    if (transition_remaining > 0)
+    {
+        // equal gain fade, both cascades filter the same signal; until the warm-up
+        // is through the standby cascade only settles on the input, unheard
+        auto* standby = standby_buffer.getWritePointer(ch);
+        run_cascade(standby_chains()[ch], standby_states()[ch], ch, standby, num_samples);
+
+        int faded = transition_length - transition_remaining; // negative while warming up
+        for (int i = juce::jmax(0, -faded); i < num_samples; i++)
+        {
+            auto gain = juce::jmin(1.f, (float)(faded + i) / transition_length);
+            data[i] += gain * (standby[i] - data[i]);
+        }
+    }
+    FDD_PROFILE_LAP(Stage_Filter);
+    kernels->subtract(cut, data, num_samples); // calculate rest of cut signal (opposite filtering)
+    FDD_PROFILE_LAP(Stage_Complement);
+
+    auto& delay_line = delay_lines[ch];
+    if (delay_ms < 0)
+    {
+        delay_line.process(data, num_samples);
+    }
+    else if (delay_ms > 0)
+    {
+        delay_line.process(cut, num_samples);
+    }
+    FDD_PROFILE_LAP(Stage_Delay);
+
+    kernels->add(data, cut, num_samples);
+    FDD_PROFILE_LAP(Stage_Sum);
+}
+
+void Split_Engine::end_block(int num_samples)
+{
+    if (transition_remaining == 0)
+        return;
+
+    transition_remaining -= num_samples;
+    if (transition_remaining <= 0)
+    {
+        transition_remaining = 0;
+        active_engine = 1 - active_engine;
+    }
+}
+
+void Split_Engine::start_transition()
+{
+    // the standby cascade settles on the live input over the next blocks before the
+    // fade starts, for as long as its slowest poles take; all channels share a design
+    warm_up_length = 0;
+    if (!standby_chains().empty())
+    {
+        Biquad_Cascade cascade;
+        cascade.clear();
+        Stage_States states;
+        std::array<int, max_cascade_sections> slots;
+        auto& chain = standby_chains()[0];
+        gather_stages(chain.get<Pass_Chain_Positions::High_Pass>(), 0, states.s1.data(), states.s2.data(), cascade, slots.data());
+        gather_stages(chain.get<Pass_Chain_Positions::Low_Pass>(), max_pass_sections, states.s1.data(), states.s2.data(), cascade, slots.data());
+        warm_up_length = (int)std::ceil(juce::jmin((double)max_warm_up_length, get_settling_samples(cascade)));
+    }
+
+    for (auto& states : standby_states())
+        states = {};
+    transition_remaining = warm_up_length + transition_length;
+}
+
+void Split_Engine::run_cascade(Pass_Chain& chain, Stage_States& states, int ch, float* data, int num_samples)
+{
+    // coefficients are read from the chain every block, so morphs and preset
+    // designs written straight into its stages are picked up as well
+    auto& cascade = cascades[ch];
+    cascade.clear();
+    std::array<int, max_cascade_sections> slots;
+    gather_stages(chain.get<Pass_Chain_Positions::High_Pass>(), 0, states.s1.data(), states.s2.data(), cascade, slots.data());
+    gather_stages(chain.get<Pass_Chain_Positions::Low_Pass>(), max_pass_sections, states.s1.data(), states.s2.data(), cascade, slots.data());
+
+    kernels->cascade(data, num_samples, cascade);
+
+    for (int section = 0; section < cascade.num_sections; section++)
+    {
+        states.s1[slots[section]] = cascade.state[0][section];
+        states.s2[slots[section]] = cascade.state[1][section];
+    }
+}
@@ -0,0 +1,172 @@
+/*
+  ==============================================================================
+
+    The split/delay engine without the plugin around it: crossover cascades,
+    the complementary band, the delay lines and the slope crossfade behind a
+    plain prepare/set_params/process interface. Needs juce_dsp only, no
+    plugin client or GUI modules.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_dsp/juce_dsp.h>
+#include <array>
+#include <limits>
+#include <utility>
+#include <vector>
+#include "DelayLine.h"
+#include "StageProfiler.h"
+
+enum Slope {
+    Slope_12,
+    Slope_24,
+    Slope_36,
+    Slope_48,
+    Slope_60,
+    Slope_72,
+    Slope_84,
+    Slope_96
+};
+
+// Second order sections needed for the steepest slope.
+constexpr int max_pass_sections = Slope_96 + 1;
+static_assert(2 * max_pass_sections <= max_cascade_sections, "both filters have to fit one cascade");
+
+// Longest delay the delay lines are allocated for (either sign).
+constexpr float max_delay_ms = 3000.f;
+
+using Filter = juce::dsp::IIR::Filter<float>;
+using Pass_Filter = juce::dsp::ProcessorChain< Filter, Filter, Filter, Filter, Filter, Filter, Filter, Filter >;
+using Pass_Chain = juce::dsp::ProcessorChain< Pass_Filter, Pass_Filter >;
+
+enum Pass_Chain_Positions {
+    High_Pass,
+    Low_Pass
+};
+
+// Calls f(std::integral_constant<int, Index>) for every stage of a Pass_Filter.
+template<typename Function, int... Indices>
+void for_each_stage(Function&& f, std::integer_sequence<int, Indices...>)
+{
+    (f(std::integral_constant<int, Indices>{}), ...);
+}
+
+template<typename Function>
+void for_each_stage(Function&& f)
+{
+    for_each_stage(f, std::make_integer_sequence<int, max_pass_sections>{});
+}
+
+// Raw b0 b1 b2 a0 a1 a2 per section, as the JUCE Butterworth designer lays them out.
+using Pass_Design = std::array<std::array<float, 6>, max_pass_sections>;
+Pass_Design design_low_pass(float frequency, double sample_rate, Slope slope);
+Pass_Design design_high_pass(float frequency, double sample_rate, Slope slope);
+
+struct Split_Params {
+    float low_pass_freq{ 20000.f }, high_pass_freq{ 20.f };
+    Slope low_pass_slope{ Slope_12 }, high_pass_slope{ Slope_12 };
+    float delay_ms{ 0.f }; // negative delays the filtered band, positive the rest
+    Delay_Storage delay_storage{ Storage_Float };
+};
+
+class Split_Engine {
+public:
+    // Allocates everything; none of the calls below allocate or lock, apart from
+    // a storage change, which reallocates the delay lines. Memory is kept across
+    // calls, and a repeat with the same rate, sizes and kernels only resets.
+    // Filters are designed by the next set_params()/set_filters().
+    void prepare(double sample_rate, int max_channels, int max_block_size);
+    void reset();
+
+    void set_params(const Split_Params& params);
+    // Channels past the prepared count are left as they are.
+    void process(float* const* channels, int num_channels, int num_samples);
+
+    double get_sample_rate() const { return sample_rate; }
+    int get_num_channels() const { return (int)delay_lines.size(); }
+    const Dsp_Kernels& get_kernels() const { return *kernels; }
+
+    //==============================================================================
+    // Finer grained control for the plugin, which also runs its multirate, allpass
+    // and morph paths over these cascades and delay lines.
+
+    // Skipped while a crossfade runs. Slope changes alone crossfade when allowed.
+    void set_filters(const Split_Params& params, double design_rate, bool allow_crossfade);
+    // Copies designs made ahead of time into the standby cascades at the engine rate
+    // and fades over to them. Returns false, leaving everything as is, while a
+    // crossfade runs; the caller tries again with a later block.
+    bool set_filters(const Pass_Design& low_pass, const Pass_Design& high_pass, const Split_Params& params);
+    // The cascades were written from outside, the next set_filters() redesigns them.
+    void invalidate_filters() { filters_up_to_date = false; }
+    // With fade set the lines fade over to the new delay instead of jumping,
+    // for delays that move while playing.
+    void set_delay(float signed_delay_ms, bool fade = false);
+    int get_delay_fade_samples() const { return delay_fade_length; }
+    // Allocates when the format changes; call it off the audio thread.
+    void set_storage(Delay_Storage new_storage);
+
+    // True from the start of the standby cascade's warm-up to the end of the fade.
+    bool is_crossfading() const { return transition_remaining > 0; }
+    void finish_crossfade();
+
+    // Channels share nothing, so they may run on different threads;
+    // end_block() follows once all of them are done.
+    void process_channel(float* data, int ch, int num_samples);
+    void end_block(int num_samples);
+
+    Pass_Chain& get_pass_chain(int ch) { return active_chains()[ch]; }
+    Delay_Line& get_delay_line(int ch) { return delay_lines[ch]; }
+    float* get_scratch(int ch) { return cut_buffer.getWritePointer(ch); }
+
+#if FDD_ENABLE_PROFILING
+    Stage_Profiler* profiler = nullptr;
+#endif
+
+private:
+    void write_filters(std::vector<Pass_Chain>& pass_chains, const Pass_Design& low_pass, const Pass_Design& high_pass, const Split_Params& params);
+    void start_transition();
+
+    // The split path runs the active stages of a chain through the pipelined
+    // cascade kernel. Their state lives here, one slot per stage, high pass
+    // first, so stages keep it when others are switched in or out.
+    struct Stage_States {
+        std::array<float, 2 * max_pass_sections> s1{}, s2{};
+    };
+    void run_cascade(Pass_Chain& chain, Stage_States& states, int ch, float* data, int num_samples);
+    std::array<std::vector<Stage_States>, 2> stage_states; // per engine and channel
+    std::vector<Biquad_Cascade> cascades;                  // per channel scratch
+
+    double sample_rate = 44100.;
+    int block_size = 0;
+    const Dsp_Kernels* kernels = &get_dsp_kernels(Path_Scalar);
+
+    // Two cascades per channel: the second only runs while a slope change fades over to it.
+    std::array<std::vector<Pass_Chain>, 2> pass_engines;
+    int active_engine = 0;
+    std::vector<Pass_Chain>& active_chains() { return pass_engines[active_engine]; }
+    std::vector<Pass_Chain>& standby_chains() { return pass_engines[1 - active_engine]; }
+    std::vector<Stage_States>& active_states() { return stage_states[active_engine]; }
+    std::vector<Stage_States>& standby_states() { return stage_states[1 - active_engine]; }
+
+    juce::AudioBuffer<float> cut_buffer;
+    std::vector<Delay_Line> delay_lines;
+    Delay_Storage storage = Storage_Float;
+    float delay_ms = 0.f;
+
+    // Last filter settings that were designed, so blocks without changes skip the designer.
+    Split_Params applied_params;
+    double applied_design_rate = 0.;
+    bool filters_up_to_date = false;
+
+    // The standby cascade runs on the live input for its settling time, capped
+    // at max_warm_up_ms, before the slope crossfade starts.
+    static constexpr float max_warm_up_ms = 100.f;
+    static constexpr float slope_fade_ms = 20.f;
+    static constexpr float delay_fade_ms = 20.f;
+    int delay_fade_length = 0;
+    juce::AudioBuffer<float> standby_buffer;
+    int max_warm_up_length = 0, warm_up_length = 0;
+    int transition_length = 0, transition_remaining = 0;
+};
@@ -0,0 +1,162 @@
+/*
+  ==============================================================================
+
+    Lock free timing of the processBlock stages and the editor frames.
+    Durations go into log2 histograms and a ring of trace events that can
+    be written out as a Chrome trace. Compiled out unless
+    FDD_ENABLE_PROFILING is set, which debug builds do by default.
+
+  ==============================================================================
+*/
+
+#include "StageProfiler.h"
+
+#if FDD_ENABLE_PROFILING
+
+namespace
+{
+    double ticks_to_us(double ticks)
+    {
+        return ticks * 1.0e6 / (double)juce::Time::getHighResolutionTicksPerSecond();
+    }
+
+    int bucket_for(juce::int64 ticks)
+    {
+        int bucket = 0;
+        while (ticks > 1 && bucket < num_histogram_buckets - 1)
+        {
+            ticks >>= 1;
+            bucket++;
+        }
+        return bucket;
+    }
+}
+
+Stage_Profiler::Stage_Profiler()
+{
+    reset();
+}
+
+const char* Stage_Profiler::get_stage_name(Profile_Stage stage)
+{
+    switch (stage)
+    {
+    case Stage_Filter: return "filter";
+    case Stage_Complement: return "complement";
+    case Stage_Delay: return "delay";
+    case Stage_Sum: return "sum";
+    case Stage_Allpass: return "allpass";
+    case Stage_Spectral: return "spectral";
+    case Stage_Multirate: return "multirate";
+    case Stage_Block: return "block";
+    case Stage_Paint: return "paint";
+    default: return "unknown";
+    }
+}
+
+void Stage_Profiler::record(Profile_Stage stage, int channel, juce::int64 start_ticks, juce::int64 end_ticks)
+{
+    auto duration = juce::jmax((juce::int64)0, end_ticks - start_ticks);
+    histograms[stage][bucket_for(duration)].fetch_add(1, std::memory_order_relaxed);
+    counts[stage].fetch_add(1, std::memory_order_relaxed);
+    total_ticks[stage].fetch_add(duration, std::memory_order_relaxed);
+
+    auto& event = events[num_events.fetch_add(1, std::memory_order_relaxed) % max_trace_events];
+    event.start.store(start_ticks, std::memory_order_relaxed);
+    event.packed.store((juce::uint64)duration << 16 | (juce::uint64)stage << 8 | (juce::uint64)((channel + 1) & 0xff),
+        std::memory_order_relaxed);
+}
+
+void Stage_Profiler::record_block(juce::int64 start_ticks, juce::int64 end_ticks, int num_samples, double sample_rate)
+{
+    record(Stage_Block, -1, start_ticks, end_ticks);
+    if (num_samples <= 0 || sample_rate <= 0)
+        return;
+
+    auto budget_us = num_samples * 1.0e6 / sample_rate;
+    auto load = (float)(ticks_to_us((double)(end_ticks - start_ticks)) / budget_us);
+    auto smoothed = cpu_load.load(std::memory_order_relaxed);
+    cpu_load.store(smoothed + 0.1f * (load - smoothed), std::memory_order_relaxed);
+}
+
+Stage_Summary Stage_Profiler::get_summary(Profile_Stage stage) const
+{
+    Stage_Summary summary;
+    summary.count = counts[stage].load(std::memory_order_relaxed);
+    if (summary.count == 0)
+        return summary;
+
+    summary.mean_us = ticks_to_us((double)total_ticks[stage].load(std::memory_order_relaxed)) / summary.count;
+
+    // percentiles are reported as the upper edge of the bucket they fall into
+    auto percentile = [&](double fraction) {
+        juce::int64 seen = 0;
+        for (int b = 0; b < num_histogram_buckets; b++)
+        {
+            seen += histograms[stage][b].load(std::memory_order_relaxed);
+            if (seen >= fraction * summary.count)
+                return ticks_to_us(std::ldexp(1., b + 1));
+        }
+        return ticks_to_us(std::ldexp(1., num_histogram_buckets));
+    };
+    summary.p50_us = percentile(0.5);
+    summary.p99_us = percentile(0.99);
+    return summary;
+}
+
+void Stage_Profiler::reset()
+{
+    for (int stage = 0; stage < num_profile_stages; stage++)
+    {
+        for (auto& bucket : histograms[stage])
+            bucket.store(0, std::memory_order_relaxed);
+        counts[stage].store(0, std::memory_order_relaxed);
+        total_ticks[stage].store(0, std::memory_order_relaxed);
+    }
+    num_events.store(0, std::memory_order_relaxed);
+    cpu_load.store(0.f, std::memory_order_relaxed);
+}
+
+bool Stage_Profiler::write_trace(const juce::File& file) const
+{
+    file.deleteFile();
+    juce::FileOutputStream stream(file);
+    if (stream.failedToOpen())
+        return false;
+
+    // complete ("X") events; tid 0 is work done on all channels, tid n is channel n - 1.
+    // Editor frames come from the message thread and get a pid of their own.
+    stream << "{\"traceEvents\":[\n";
+    auto total = num_events.load(std::memory_order_relaxed);
+    auto first = total > (juce::uint64)max_trace_events ? total - max_trace_events : 0;
+    for (auto i = first; i < total; i++)
+    {
+        auto& event = events[i % max_trace_events];
+        auto packed = event.packed.load(std::memory_order_relaxed);
+        auto stage = (Profile_Stage)((packed >> 8) & 0xff);
+        stream << (i == first ? "" : ",\n")
+            << "{\"name\":\"" << get_stage_name(stage) << "\",\"ph\":\"X\",\"pid\":" << (stage == Stage_Paint ? 2 : 1)
+            << ",\"tid\":" << (int)(packed & 0xff)
+            << ",\"ts\":" << juce::String(ticks_to_us((double)event.start.load(std::memory_order_relaxed)), 3)
+            << ",\"dur\":" << juce::String(ticks_to_us((double)(packed >> 16)), 3) << "}";
+    }
+    stream << "\n],\n\"stageHistograms\":{\n";
+
+    for (int stage = 0; stage < num_profile_stages; stage++)
+    {
+        auto summary = get_summary((Profile_Stage)stage);
+        stream << (stage == 0 ? "" : ",\n")
+            << "\"" << get_stage_name((Profile_Stage)stage) << "\":{\"count\":" << summary.count
+            << ",\"mean_us\":" << juce::String(summary.mean_us, 3)
+            << ",\"p50_us\":" << juce::String(summary.p50_us, 3)
+            << ",\"p99_us\":" << juce::String(summary.p99_us, 3)
+            << ",\"log2_tick_buckets\":[";
+        for (int b = 0; b < num_histogram_buckets; b++)
+            stream << (b == 0 ? "" : ",") << (int)histograms[stage][b].load(std::memory_order_relaxed);
+        stream << "]}";
+    }
+    stream << "\n}}\n";
+    return stream.getStatus().wasOk();
+}
+
+#endif
@@ -0,0 +1,126 @@
+/*
+  ==============================================================================
+
+    Lock free timing of the processBlock stages and the editor frames.
+    Durations go into log2 histograms and a ring of trace events that can
+    be written out as a Chrome trace. Compiled out unless
+    FDD_ENABLE_PROFILING is set, which debug builds do by default.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <array>
+#include <atomic>
+
+#ifndef FDD_ENABLE_PROFILING
+ #define FDD_ENABLE_PROFILING JUCE_DEBUG
+#endif
+
+#if FDD_ENABLE_PROFILING
+
+enum Profile_Stage {
+    Stage_Filter,
+    Stage_Complement,
+    Stage_Delay,
+    Stage_Sum,
+    Stage_Allpass,
+    Stage_Spectral,
+    Stage_Multirate,
+    Stage_Block,
+    Stage_Paint, // a whole editor frame, on the message thread
+    num_profile_stages
+};
+
+constexpr int num_histogram_buckets = 40; // bucket b holds durations of [2^b, 2^(b+1)) ticks
+constexpr int max_trace_events = 1 << 16;
+
+struct Stage_Summary {
+    juce::int64 count{ 0 };
+    double mean_us{ 0 }, p50_us{ 0 }, p99_us{ 0 };
+};
+
+class Stage_Profiler {
+public:
+    Stage_Profiler();
+
+    static const char* get_stage_name(Profile_Stage stage);
+
+    // Any thread, several channel workers may record at the same time.
+    // channel -1 stands for work done on all channels at once.
+    void record(Profile_Stage stage, int channel, juce::int64 start_ticks, juce::int64 end_ticks);
+    void record_block(juce::int64 start_ticks, juce::int64 end_ticks, int num_samples, double sample_rate);
+
+    // Smoothed share of the real time budget the blocks take, 1 means 100%.
+    float get_cpu_load() const { return cpu_load.load(std::memory_order_relaxed); }
+    Stage_Summary get_summary(Profile_Stage stage) const;
+
+    // Name of the kernels the stages run with, shown next to the load.
+    void set_kernels_name(const char* name) { kernels_name = name; }
+    const char* get_kernels_name() const { return kernels_name.load(); }
+
+    // Not synchronised with record(), events written meanwhile may come out torn.
+    void reset();
+    bool write_trace(const juce::File& file) const;
+
+private:
+    struct Trace_Event {
+        std::atomic<juce::int64> start{ 0 };
+        std::atomic<juce::uint64> packed{ 0 }; // duration << 16 | stage << 8 | channel + 1
+    };
+
+    std::array<std::array<std::atomic<juce::uint32>, num_histogram_buckets>, num_profile_stages> histograms;
+    std::array<std::atomic<juce::int64>, num_profile_stages> counts, total_ticks;
+    std::array<Trace_Event, max_trace_events> events;
+    std::atomic<juce::uint64> num_events{ 0 };
+    std::atomic<float> cpu_load{ 0.f };
+    std::atomic<const char*> kernels_name{ "" };
+};
+
+// Times consecutive stages, each lap ends one stage and starts the next.
+// A null profiler (an engine nobody attached one to) records nothing.
+class Stage_Clock {
+public:
+    Stage_Clock(Stage_Profiler* p, int c) : profiler(p), channel(c), last(juce::Time::getHighResolutionTicks()) {}
+    Stage_Clock(Stage_Profiler& p, int c) : Stage_Clock(&p, c) {}
+
+    void lap(Profile_Stage stage)
+    {
+        if (profiler == nullptr)
+            return;
+        auto now = juce::Time::getHighResolutionTicks();
+        profiler->record(stage, channel, last, now);
+        last = now;
+    }
+
+private:
+    Stage_Profiler* profiler;
+    int channel;
+    juce::int64 last;
+};
+
+class Block_Timer {
+public:
+    Block_Timer(Stage_Profiler& p, int n, double sr) : profiler(p), num_samples(n), sample_rate(sr), start(juce::Time::getHighResolutionTicks()) {}
+    ~Block_Timer() { profiler.record_block(start, juce::Time::getHighResolutionTicks(), num_samples, sample_rate); }
+
+private:
+    Stage_Profiler& profiler;
+    int num_samples;
+    double sample_rate;
+    juce::int64 start;
+};
+
+ #define FDD_PROFILE_BLOCK(profiler, num_samples, sample_rate) Block_Timer block_timer(profiler, num_samples, sample_rate)
+ #define FDD_PROFILE_BEGIN(profiler, channel) Stage_Clock stage_clock(profiler, channel)
+ #define FDD_PROFILE_LAP(stage) stage_clock.lap(stage)
+
+#else
+
+ #define FDD_PROFILE_BLOCK(profiler, num_samples, sample_rate)
+ #define FDD_PROFILE_BEGIN(profiler, channel)
+ #define FDD_PROFILE_LAP(stage)
+
+#endif
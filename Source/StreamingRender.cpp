@@ -0,0 +1,197 @@
+/*
+  ==============================================================================
+
+    Offline file rendering that keeps the DSP busy: the input is memory
+    mapped and read ahead on an I/O thread, the output is written on
+    another, and the blocks travel between the three through a bounded
+    ring of preallocated buffers.
+
+  ==============================================================================
+*/
+
+#include "StreamingRender.h"
+#include <atomic>
+#include <vector>
+
+namespace
+{
+    constexpr int map_window_blocks = 64; // the input is mapped a window at a time, so 32 bit hosts cope too
+
+    class Stage_Thread : public juce::Thread {
+    public:
+        Stage_Thread(const juce::String& name, std::function<void()> b) : juce::Thread(name), body(std::move(b)) {}
+        void run() override { body(); }
+    private:
+        std::function<void()> body;
+    };
+
+    // Slot k % num_slots carries block k: the reader fills it, the DSP processes
+    // it and the writer frees it again. Each counter only ever grows.
+    struct Block_Ring {
+        std::vector<juce::AudioBuffer<float>> slots;
+        std::vector<int> lengths;
+        std::atomic<juce::int64> filled{ 0 }, processed{ 0 }, written{ 0 };
+        juce::WaitableEvent filled_event, processed_event, written_event;
+        std::atomic<bool> failed{ false };
+        juce::String error;
+
+        void fail(const juce::String& message)
+        {
+            if (!failed.exchange(true))
+                error = message;
+            filled_event.signal();
+            processed_event.signal();
+            written_event.signal();
+        }
+
+        // False once any stage failed.
+        template<typename Ready>
+        bool wait_for(juce::WaitableEvent& event, Ready ready)
+        {
+            while (!ready())
+            {
+                if (failed.load())
+                    return false;
+                event.wait(100);
+            }
+            return !failed.load();
+        }
+    };
+
+    double seconds_since(juce::int64 start_ticks)
+    {
+        return juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start_ticks);
+    }
+}
+
+Stream_Render_Result render_stream(const juce::File& input, const juce::File& output,
+    const Stream_Prepare& prepare, const Stream_Process& process_block, Stream_Render_Options options)
+{
+    Stream_Render_Result result;
+    auto render_start = juce::Time::getHighResolutionTicks();
+
+    juce::WavAudioFormat wav;
+    std::unique_ptr<juce::MemoryMappedAudioFormatReader> reader(wav.createMemoryMappedReader(input));
+    if (reader == nullptr)
+    {
+        result.error = "can't open " + input.getFullPathName() + " as WAV or RF64";
+        return result;
+    }
+
+    auto num_channels = (int)reader->numChannels;
+    auto length = reader->lengthInSamples;
+    auto block_size = juce::jmax(1, options.block_size);
+    auto num_slots = juce::jmax(2, options.num_slots);
+
+    output.deleteFile();
+    auto stream = std::make_unique<juce::FileOutputStream>(output);
+    if (stream->failedToOpen())
+    {
+        result.error = "can't write " + output.getFullPathName();
+        return result;
+    }
+    std::unique_ptr<juce::AudioFormatWriter> writer(wav.createWriterFor(stream.get(), reader->sampleRate,
+        (unsigned int)num_channels, options.bits_per_sample, {}, 0));
+    if (writer == nullptr)
+    {
+        result.error = "unsupported output format";
+        return result;
+    }
+    stream.release(); // the writer owns it now
+
+    Block_Ring ring;
+    ring.slots.resize((size_t)num_slots);
+    for (auto& slot : ring.slots)
+        slot.setSize(num_channels, block_size);
+    ring.lengths.assign((size_t)num_slots, 0);
+
+    // the DSP runs over the input and then the latency's worth of silence
+    auto latency = (juce::int64)juce::jmax(0, prepare(num_channels, reader->sampleRate, block_size));
+    auto processed_length = length + latency;
+    auto num_blocks = (processed_length + block_size - 1) / block_size;
+
+    std::atomic<juce::int64> output_wait_ticks{ 0 };
+    Stage_Thread reading("Render Reader", [&] {
+        for (juce::int64 k = 0; k < num_blocks; k++)
+        {
+            auto wait_start = juce::Time::getHighResolutionTicks();
+            if (!ring.wait_for(ring.written_event, [&] { return k - ring.written.load() < num_slots; }))
+                return;
+            output_wait_ticks += juce::Time::getHighResolutionTicks() - wait_start;
+
+            auto start = k * block_size;
+            auto n = (int)juce::jmin((juce::int64)block_size, processed_length - start);
+            auto n_input = (int)juce::jlimit((juce::int64)0, (juce::int64)n, length - start);
+            auto& slot = ring.slots[(size_t)(k % num_slots)];
+            if (n_input > 0)
+            {
+                if (!reader->getMappedSection().contains(juce::Range<juce::int64>(start, start + n_input))
+                    && !reader->mapSectionOfFile({ start, juce::jmin(length, start + (juce::int64)block_size * map_window_blocks) }))
+                {
+                    ring.fail("can't map " + input.getFullPathName());
+                    return;
+                }
+                if (!reader->read(slot.getArrayOfWritePointers(), num_channels, start, n_input))
+                {
+                    ring.fail("read error in " + input.getFullPathName());
+                    return;
+                }
+            }
+            for (int ch = 0; ch < num_channels; ch++)
+                slot.clear(ch, n_input, n - n_input);
+            ring.lengths[(size_t)(k % num_slots)] = n;
+            ring.filled = k + 1;
+            ring.filled_event.signal();
+        }
+    });
+
+    Stage_Thread writing("Render Writer", [&] {
+        for (juce::int64 k = 0; k < num_blocks; k++)
+        {
+            if (!ring.wait_for(ring.processed_event, [&] { return ring.processed.load() > k; }))
+                return;
+
+            // the first latency samples of the output only hold the processing's delay
+            auto& slot = ring.slots[(size_t)(k % num_slots)];
+            auto skip = (int)juce::jlimit((juce::int64)0, (juce::int64)ring.lengths[(size_t)(k % num_slots)], latency - k * block_size);
+            auto n = ring.lengths[(size_t)(k % num_slots)] - skip;
+            if (n > 0 && !writer->writeFromAudioSampleBuffer(slot, skip, n))
+            {
+                ring.fail("write error in " + output.getFullPathName());
+                return;
+            }
+            ring.written = k + 1;
+            ring.written_event.signal();
+        }
+    });
+
+    reading.startThread();
+    writing.startThread();
+
+    for (juce::int64 k = 0; k < num_blocks; k++)
+    {
+        auto wait_start = juce::Time::getHighResolutionTicks();
+        if (!ring.wait_for(ring.filled_event, [&] { return ring.filled.load() > k; }))
+            break;
+        result.input_wait_seconds += seconds_since(wait_start);
+
+        auto dsp_start = juce::Time::getHighResolutionTicks();
+        auto& slot = ring.slots[(size_t)(k % num_slots)];
+        process_block(slot.getArrayOfWritePointers(), num_channels, ring.lengths[(size_t)(k % num_slots)]);
+        result.dsp_seconds += seconds_since(dsp_start);
+
+        ring.processed = k + 1;
+        ring.processed_event.signal();
+    }
+
+    reading.waitForThreadToExit(-1);
+    writing.waitForThreadToExit(-1);
+    writer.reset(); // finishes the header
+
+    result.output_wait_seconds = juce::Time::highResolutionTicksToSeconds(output_wait_ticks.load());
+    result.seconds = seconds_since(render_start);
+    result.ok = !ring.failed.load();
+    result.error = ring.error;
+    result.num_samples = result.ok ? length : juce::jmax((juce::int64)0, ring.written.load() * block_size - latency);
+    return result;
+}
@@ -0,0 +1,43 @@
+/*
+  ==============================================================================
+
+    Offline file rendering that keeps the DSP busy: the input is memory
+    mapped and read ahead on an I/O thread, the output is written on
+    another, and the blocks travel between the three through a bounded
+    ring of preallocated buffers.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <functional>
+
+struct Stream_Render_Options {
+    int block_size{ 8192 };
+    int num_slots{ 8 };        // blocks in flight between reader, DSP and writer
+    int bits_per_sample{ 24 }; // 16, 24 or 32 (float)
+};
+
+struct Stream_Render_Result {
+    bool ok{ false };
+    bool cached{ false }; // copied from a render cache, nothing was processed
+    juce::String error;
+    juce::int64 num_samples{ 0 };
+    double seconds{ 0 };
+    double dsp_seconds{ 0 };        // inside process_block
+    double input_wait_seconds{ 0 }; // DSP starved by the reader
+    double output_wait_seconds{ 0 }; // reader held back by the writer
+};
+
+// Channels, sample rate and block size of the input, known before the first block.
+// Returns the latency of the processing: that many samples are dropped from the
+// start of the output and flushed out with silence at the end.
+using Stream_Prepare = std::function<int(int num_channels, double sample_rate, int block_size)>;
+// Runs on the calling thread, in place, one block at a time and in order.
+using Stream_Process = std::function<void(float* const* channels, int num_channels, int num_samples)>;
+
+// WAV or RF64 in, WAV out (RF64 once it passes 4 GB).
+Stream_Render_Result render_stream(const juce::File& input, const juce::File& output,
+    const Stream_Prepare& prepare, const Stream_Process& process_block, Stream_Render_Options options = {});
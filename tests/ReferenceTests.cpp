@@ -0,0 +1,83 @@
+/*
+  ==============================================================================
+
+    Test driver around the reference renders, one check per ctest entry:
+
+      fdd_tests null                          split and multirate sum back to the input
+      fdd_tests cpu-paths                     SIMD kernels against the scalar ones
+      fdd_tests golden <directory> [--record] scalar renders against the goldens
+
+    Returns 0 on success and 1 on a failure, a missing golden included.
+
+  ==============================================================================
+*/
+
+#include "ReferenceRender.h"
+
+namespace
+{
+    // The split and its complement are summed in float, so the null is not exact.
+    // Near zero crossings a tiny error spans any number of ulps, so only the
+    // absolute error bounds the null.
+    constexpr Render_Tolerance null_tolerance{ 1.0e-6f, std::numeric_limits<int>::max() };
+    // The kernels are built without FMA contraction and keep the scalar operation
+    // order in every lane, so the SIMD paths are bit exact.
+    constexpr Render_Tolerance cpu_path_tolerance{ 0.f, 0 };
+    constexpr Render_Tolerance golden_tolerance{ 0.f, 0 };
+
+    int report(const juce::String& test, const juce::StringArray& failures)
+    {
+        for (auto& failure : failures)
+            std::cerr << test << ": " << failure << std::endl;
+        std::cout << test << ": " << (failures.isEmpty() ? "passed" : "failed") << std::endl;
+        return failures.isEmpty() ? 0 : 1;
+    }
+
+    int run_null()
+    {
+        juce::StringArray failures;
+        auto matrix = make_reference_matrix();
+        for (size_t i = 0; i < matrix.size(); i++)
+        {
+            if (!nulls_at_zero_delay(matrix[i]))
+                continue;
+            auto comparison = run_null_render(matrix[i], null_tolerance);
+            if (!comparison.passed)
+                failures.add("case " + juce::String((int)i) + ": max error " + juce::String(comparison.max_abs_error));
+        }
+        return report("null", failures);
+    }
+
+    int run_cpu_paths()
+    {
+        juce::StringArray failures;
+        for (auto& reference_case : make_reference_matrix())
+            failures.addArray(run_cpu_path_renders(reference_case, cpu_path_tolerance));
+        return report("cpu-paths", failures);
+    }
+
+    int run_golden(const juce::File& directory, bool record)
+    {
+        return report("golden", run_golden_renders(directory, golden_tolerance, record));
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    // parameter attachments and timers need a message manager
+    juce::ScopedJuceInitialiser_GUI juce_initialiser;
+
+    juce::StringArray args;
+    for (int i = 1; i < argc; i++)
+        args.add(argv[i]);
+
+    if (args[0] == "null")
+        return run_null();
+    if (args[0] == "cpu-paths")
+        return run_cpu_paths();
+    if (args[0] == "golden" && args.size() >= 2)
+        return run_golden(juce::File::getCurrentWorkingDirectory().getChildFile(args[1]), args.contains("--record"));
+
+    std::cerr << "usage: fdd_tests null | cpu-paths | golden <directory> [--record]" << std::endl;
+    return 1;
+}
@@ -0,0 +1,68 @@
+/*
+  ==============================================================================
+
+    Many engines in one process, the way an audio server would host them:
+    prepare time per instance and the processing load of all of them together.
+
+      fdd_bench [instances] [block size]
+
+  ==============================================================================
+*/
+
+#include "SplitEngine.h"
+#include <iostream>
+#include <memory>
+
+namespace
+{
+    constexpr double bench_sample_rate = 48000.;
+    constexpr int bench_channels = 2;
+    constexpr double bench_seconds = 10.;
+
+    double elapsed_ms(juce::int64 start_ticks)
+    {
+        return 1000. * juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start_ticks);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    auto num_instances = juce::jmax(1, argc > 1 ? juce::String(argv[1]).getIntValue() : 200);
+    auto block_size = juce::jmax(1, argc > 2 ? juce::String(argv[2]).getIntValue() : 512);
+
+    Split_Params params;
+    params.high_pass_freq = 1000.f;
+    params.high_pass_slope = Slope_48;
+    params.delay_ms = -10.f;
+
+    std::vector<std::unique_ptr<Split_Engine>> engines;
+    engines.reserve((size_t)num_instances);
+    auto start = juce::Time::getHighResolutionTicks();
+    for (int i = 0; i < num_instances; i++)
+    {
+        engines.push_back(std::make_unique<Split_Engine>());
+        engines.back()->prepare(bench_sample_rate, bench_channels, block_size);
+        engines.back()->set_params(params);
+    }
+    auto prepare_ms = elapsed_ms(start) / num_instances;
+
+    juce::AudioBuffer<float> block(bench_channels, block_size);
+    juce::Random random(1234);
+    for (int ch = 0; ch < bench_channels; ch++)
+        for (int i = 0; i < block_size; i++)
+            block.setSample(ch, i, random.nextFloat() - 0.5f);
+
+    auto num_blocks = (int)(bench_seconds * bench_sample_rate / block_size);
+    start = juce::Time::getHighResolutionTicks();
+    for (int b = 0; b < num_blocks; b++)
+        for (auto& engine : engines)
+            engine->process(block.getArrayOfWritePointers(), bench_channels, block_size);
+    auto process_ms = elapsed_ms(start);
+
+    auto audio_ms = 1000. * num_blocks * block_size / bench_sample_rate;
+    std::cout << num_instances << " engines, " << get_cpu_path_name(engines[0]->get_kernels().path) << " kernels" << std::endl
+              << "prepare: " << prepare_ms << " ms per instance" << std::endl
+              << "process: " << 100. * process_ms / audio_ms << " % of one core for all of them, "
+              << 100. * process_ms / audio_ms / num_instances << " % per instance" << std::endl;
+    return 0;
+}
@@ -0,0 +1,71 @@
+/*
+  ==============================================================================
+
+    Runs a WAV/RF64 file through the split/delay engine alone, without the
+    processor, parameters or plugin modules:
+
+      fdd_process <input> <output> [--low-pass Hz] [--high-pass Hz]
+                  [--slope 12..96] [--delay ms] [--packed]
+
+  ==============================================================================
+*/
+
+#include "SplitEngine.h"
+#include "StreamingRender.h"
+#include <iostream>
+
+namespace
+{
+    float read_option(const juce::StringArray& args, const char* name, float fallback)
+    {
+        auto index = args.indexOf(name);
+        return index >= 0 && index + 1 < args.size() ? args[index + 1].getFloatValue() : fallback;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    juce::StringArray args;
+    for (int i = 1; i < argc; i++)
+        args.add(argv[i]);
+
+    if (args.size() < 2)
+    {
+        std::cerr << "usage: fdd_process <input> <output> [--low-pass Hz] [--high-pass Hz]"
+                     " [--slope 12..96] [--delay ms] [--packed]" << std::endl;
+        return 1;
+    }
+
+    Split_Params params;
+    params.low_pass_freq = read_option(args, "--low-pass", params.low_pass_freq);
+    params.high_pass_freq = read_option(args, "--high-pass", params.high_pass_freq);
+    auto slope = (Slope)juce::jlimit((int)Slope_12, (int)Slope_96, juce::roundToInt(read_option(args, "--slope", 12.f) / 12.f) - 1);
+    params.low_pass_slope = params.high_pass_slope = slope;
+    params.delay_ms = juce::jlimit(-max_delay_ms, max_delay_ms, read_option(args, "--delay", 0.f));
+    params.delay_storage = args.contains("--packed") ? Storage_Packed_24 : Storage_Float;
+
+    Split_Engine engine;
+    auto prepare = [&](int num_channels, double sample_rate, int block_size)
+    {
+        engine.set_storage(params.delay_storage);
+        engine.prepare(sample_rate, num_channels, block_size);
+        engine.set_params(params);
+        return 0;
+    };
+    auto process = [&](float* const* channels, int num_channels, int num_samples)
+    {
+        engine.process(channels, num_channels, num_samples);
+    };
+
+    auto cwd = juce::File::getCurrentWorkingDirectory();
+    auto result = render_stream(cwd.getChildFile(args[0]), cwd.getChildFile(args[1]), prepare, process);
+    if (!result.ok)
+    {
+        std::cerr << result.error << std::endl;
+        return 1;
+    }
+
+    std::cout << result.num_samples << " samples in " << result.seconds << " s, "
+              << result.dsp_seconds << " s of it in the engine" << std::endl;
+    return 0;
+}
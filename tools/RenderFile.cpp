@@ -0,0 +1,121 @@
+/*
+  ==============================================================================
+
+    Offline renders through the whole processor, every mode included, with
+    the latency compensated. With --cache, renders of an unchanged input,
+    state and build are copied from the cache instead:
+
+      fdd_render <input> <output> [--low-pass Hz] [--high-pass Hz]
+                 [--slope 12..96] [--delay ms]
+                 [--mode split|allpass|spectral|multirate] [--curve file]
+                 [--cache directory] [--cache-mb size]
+
+    The allpass and spectral modes need --curve, a text file with one
+    "frequency_hz delay_ms" point per line; lines starting with # are skipped.
+
+  ==============================================================================
+*/
+
+#include "ReferenceRender.h"
+
+namespace
+{
+    constexpr float default_cache_mb = 4096.f;
+
+    float read_option(const juce::StringArray& args, const char* name, float fallback)
+    {
+        auto index = args.indexOf(name);
+        return index >= 0 && index + 1 < args.size() ? args[index + 1].getFloatValue() : fallback;
+    }
+
+    juce::String read_option(const juce::StringArray& args, const char* name, const juce::String& fallback)
+    {
+        auto index = args.indexOf(name);
+        return index >= 0 && index + 1 < args.size() ? args[index + 1] : fallback;
+    }
+
+    bool read_curve(const juce::File& file, std::vector<Curve_Point>& curve)
+    {
+        juce::StringArray lines;
+        file.readLines(lines);
+        for (auto& line : lines)
+        {
+            auto tokens = juce::StringArray::fromTokens(line.trim(), " \t,", {});
+            if (tokens.isEmpty() || tokens[0].startsWith("#"))
+                continue;
+            if (tokens.size() != 2)
+                return false;
+            curve.push_back({ tokens[0].getFloatValue(), tokens[1].getFloatValue() });
+        }
+        return !curve.empty();
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    // parameter attachments and timers need a message manager
+    juce::ScopedJuceInitialiser_GUI juce_initialiser;
+
+    juce::StringArray args;
+    for (int i = 1; i < argc; i++)
+        args.add(argv[i]);
+
+    auto modes = juce::StringArray{ "split", "allpass", "spectral", "multirate" };
+    auto mode = modes.indexOf(read_option(args, "--mode", juce::String("split")));
+    auto curve_path = read_option(args, "--curve", juce::String());
+    auto needs_curve = mode == Delay_Mode::Mode_Allpass || mode == Delay_Mode::Mode_Spectral;
+    if (args.size() < 2 || mode < 0 || (needs_curve && curve_path.isEmpty()))
+    {
+        std::cerr << "usage: fdd_render <input> <output> [--low-pass Hz] [--high-pass Hz] [--slope 12..96] [--delay ms]"
+                     " [--mode split|allpass|spectral|multirate] [--curve file] [--cache directory] [--cache-mb size]" << std::endl
+                  << "the allpass and spectral modes need --curve" << std::endl;
+        return 1;
+    }
+
+    Chain_Settings settings;
+    settings.low_pass_freq = read_option(args, "--low-pass", settings.low_pass_freq);
+    settings.high_pass_freq = read_option(args, "--high-pass", settings.high_pass_freq);
+    auto slope = (Slope)juce::jlimit((int)Slope_12, (int)Slope_96, juce::roundToInt(read_option(args, "--slope", 12.f) / 12.f) - 1);
+    settings.low_pass_slope = settings.high_pass_slope = slope;
+    settings.delay_ms = juce::jlimit(-max_delay_ms, max_delay_ms, read_option(args, "--delay", 0.f));
+    settings.mode = (Delay_Mode)mode;
+
+    auto cwd = juce::File::getCurrentWorkingDirectory();
+    auto input = cwd.getChildFile(args[0]);
+    auto output = cwd.getChildFile(args[1]);
+    auto cache_directory = read_option(args, "--cache", juce::String());
+    FreqencyDependentDelayerAudioProcessor processor;
+    if (curve_path.isNotEmpty())
+    {
+        // set before rendering, so it is part of the state the cache key is made from
+        std::vector<Curve_Point> curve;
+        if (!read_curve(cwd.getChildFile(curve_path), curve))
+        {
+            std::cerr << "cannot read a curve from " << curve_path << std::endl;
+            return 1;
+        }
+        processor.set_group_delay_curve(curve);
+    }
+    Stream_Render_Result result;
+    if (cache_directory.isNotEmpty())
+    {
+        Render_Cache cache(cwd.getChildFile(cache_directory), (juce::int64)(read_option(args, "--cache-mb", default_cache_mb) * (1 << 20)));
+        result = render_file_cached(processor, settings, input, output, cache);
+    }
+    else
+    {
+        result = render_file(processor, settings, input, output);
+    }
+    if (!result.ok)
+    {
+        std::cerr << result.error << std::endl;
+        return 1;
+    }
+
+    if (result.cached)
+        std::cout << "copied from the cache in " << result.seconds << " s" << std::endl;
+    else
+        std::cout << result.num_samples << " samples in " << result.seconds << " s, "
+                  << result.dsp_seconds << " s of it in the processor" << std::endl;
+    return 0;
+}
@@ -0,0 +1,38 @@
+/*
+  ==============================================================================
+
+    Session load timing: constructs and prepares many processors the way a
+    host does, see run_startup_benchmark().
+
+      fdd_startup_bench [instances] [sample rate] [block size]
+
+  ==============================================================================
+*/
+
+#include "ReferenceRender.h"
+
+int main(int argc, char* argv[])
+{
+    // parameter attachments and timers need a message manager
+    juce::ScopedJuceInitialiser_GUI juce_initialiser;
+
+    auto num_instances = argc > 1 ? juce::String(argv[1]).getIntValue() : 200;
+    auto sample_rate = argc > 2 ? juce::String(argv[2]).getDoubleValue() : 48000.;
+    auto block_size = argc > 3 ? juce::String(argv[3]).getIntValue() : 512;
+    if (num_instances <= 0 || sample_rate <= 0. || block_size <= 0)
+    {
+        std::cerr << "usage: fdd_startup_bench [instances] [sample rate] [block size]" << std::endl;
+        return 1;
+    }
+
+    auto timing = run_startup_benchmark(num_instances, sample_rate, block_size);
+    std::cout << timing.num_instances << " instances, mean ms per instance" << std::endl
+              << "construct:     " << timing.construct_ms << std::endl
+              << "prepare:       " << timing.prepare_ms << std::endl
+              << "first block:   " << timing.first_block_ms << std::endl
+              << "prepare again: " << timing.prepare_again_ms << std::endl
+              << "rate change:   " << timing.rate_change_ms << std::endl
+              << "destroy:       " << timing.destroy_ms << std::endl
+              << "threads:       " << timing.num_threads << " in total" << std::endl;
+    return 0;
+}